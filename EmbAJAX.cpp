@@ -30,6 +30,22 @@
 
 // statics
 EmbAJAXOutputDriverBase *EmbAJAXBase::_driver;
+EmbAJAXUpdatePass *EmbAJAXBase::_update_pass = 0;
+EmbAJAXUpdateClasses *EmbAJAXBase::_update_classes = 0;
+EmbAJAXElement* volatile EmbAJAXElement::_refreshing = 0;
+volatile bool EmbAJAXElement::_other_change = false;
+bool EmbAJAXElement::_held_back = false;
+EmbAJAXSharedCounter EmbAJAXTransaction::_depth;
+EmbAJAXSharedCounter EmbAJAXThrottle::_num_pending;
+#if EMBAJAX_VIEWPORT_UPDATES
+EmbAJAXClientView *EmbAJAXBase::_client_view = 0;
+#endif
+#if EMBAJAX_METRICS
+EmbAJAXMetrics EmbAJAXBase::_metrics;
+#define EMBAJAX_COUNT(counter) ++EmbAJAXBase::_metrics.counter
+#else
+#define EMBAJAX_COUNT(counter) do {} while (0)
+#endif
 char EmbAJAXBase::itoa_buf[ITOA_BUFLEN];
 constexpr const char EmbAJAXBase::null_string[1];
 
@@ -58,9 +74,24 @@ void EmbAJAXOutputDriverBase::_printFiltered(const char* value, QuoteMode quoted
     if (quoted) _printChar('"');
 }
 
+size_t EmbAJAXOutputDriverBase::filteredLength(const char* value, QuoteMode quoted, bool HTMLescaped) {
+    // NOTE: Keep in sync with _printFiltered(), above
+    size_t len = quoted ? 2 : 0;
+    for (const char *pos = value; *pos != '\0'; ++pos) {
+        if ((quoted == JSQuoted) && (*pos == '"' || *pos == '\\' || *pos == '\n')) len += 2;
+        else if ((quoted == HTMLQuoted) && (*pos == '"')) len += 6;
+        else if (HTMLescaped && (*pos == '<')) len += 4;
+        else if (HTMLescaped && (*pos == '&')) len += 5;
+        else len += 1;
+    }
+    return len;
+}
+
 void EmbAJAXOutputDriverBase::commitBuffer() {
+    if (_bufpos == 0) return;
     _buf[_bufpos] = '\0';
-    printContent(_buf);
+    outputContent(_buf, _bufpos);
+    EMBAJAX_COUNT(buffer_flushes);
     _bufpos = 0;
 }
 
@@ -70,15 +101,33 @@ void EmbAJAXOutputDriverBase::_printChar(const char value) {
 }
 
 void EmbAJAXOutputDriverBase::_printContent(const char* value) {
+    _printContent(value, strlen(value));
+}
+
+void EmbAJAXOutputDriverBase::_printContent(const char* value, size_t len) {
     // NOTE: The assumption, here is that frequent (char-by-char) calls to printContent() _could_ be expensive, depending on the server
-    //       implementation. Thus, a buffer is used to enable printing in larger chunks.
-    const char *pos = value;
-    while(*pos != '\0') {
-        _printChar(*pos);
-        ++pos;
+    //       implementation. Thus, a buffer is used to enable printing in larger chunks. Strings that would not fit into the buffer, anyway,
+    //       are passed on without copying.
+    if (len >= (size_t) _bufsize) {
+        commitBuffer();
+        outputContent(value, len);
+        return;
+    }
+    while (len) {
+        size_t chunk = min(len, (size_t) (_bufsize - 1 - _bufpos));
+        memcpy(&_buf[_bufpos], value, chunk);
+        _bufpos += chunk;
+        value += chunk;
+        len -= chunk;
+        if (_bufpos >= _bufsize - 1) commitBuffer();
     }
 }
 
+void EmbAJAXOutputDriverBase::_printInt(int value) {
+    char buf[12];
+    _printContent(itoa(value, buf, 10));
+}
+
 #define handleOneChar() {                                           \
     if (c == JS_QUOTED_STRING_ARG[0]) {                             \
             _printFiltered(va_arg(args, char*), JSQuoted, false);   \
@@ -87,8 +136,7 @@ void EmbAJAXOutputDriverBase::_printContent(const char* value) {
         } else if (c == HTML_ESCAPED_STRING_ARG[0]) {               \
             _printFiltered(va_arg(args, char*), NotQuoted, true);   \
         } else if (c == INTEGER_VALUE_ARG[0]) {                     \
-            char buf[12];                                           \
-            _printContent(itoa(va_arg(args, int), buf, 10));        \
+            _printInt(va_arg(args, int));                           \
         } else if (c == PLAIN_STRING_ARG[0]) {                      \
             _printContent(va_arg(args, char*));                     \
         } else {                                                    \
@@ -137,38 +185,224 @@ void EmbAJAXOutputDriverBase::_printContentF(const __FlashStringHelper* _fmt, ..
 #endif
 
 void EmbAJAXOutputDriverBase::printAttribute(const char* name, const char* value) {
-    _printContentF(" " PLAIN_STRING_ARG "=" HTML_QUOTED_STRING_ARG, name, value);
+    printFormatted(" ", PLAIN_STRING(name), "=", HTML_QUOTED_STRING(value));
 }
 
 void EmbAJAXOutputDriverBase::printAttribute(const char* name, const int32_t value) {
-    _printContentF(" " PLAIN_STRING_ARG "=" INTEGER_VALUE_ARG, name, value);
+    printFormatted(" ", PLAIN_STRING(name), "=", INTEGER_VALUE(value));
+}
+
+/** Decode a URI component, in place. */
+static void urlDecode(char* value) {
+    char* out = value;
+    while (*value) {
+        char c = *value;
+        if (c == '+') {
+            c = ' ';
+        } else if (c == '%' && isxdigit(value[1]) && isxdigit(value[2])) {
+            char hex[3] = { value[1], value[2], '\0' };
+            c = strtol(hex, 0, 16);
+            value += 2;
+        }
+        *(out++) = c;
+        ++value;
+    }
+    *out = '\0';
+}
+
+void EmbAJAXOutputDriverBase::parseRequestBody(char* body) {
+    _numargs = 0;
+    while (body && _numargs < EMBAJAX_MAX_ARGS) {
+        char* next = strchr(body, '&');
+        if (next) *(next++) = '\0';
+        if (*body) {
+            char* value = strchr(body, '=');
+            if (value) *(value++) = '\0';
+            else value = body + strlen(body);
+            urlDecode(body);
+            urlDecode(value);
+            _argnames[_numargs] = body;
+            _argvalues[_numargs] = value;
+            ++_numargs;
+        }
+        body = next;
+    }
+}
+
+const char* EmbAJAXOutputDriverBase::getParsedArg(const char* name, char* buf, int buflen) const {
+    if (!_numargs) return 0;
+    buf[0] = '\0';
+    for (uint8_t i = 0; i < _numargs; ++i) {
+        if (strcmp(name, _argnames[i]) == 0) {
+            strncpy(buf, _argvalues[i], buflen-1);
+            buf[buflen-1] = '\0';
+            break;
+        }
+    }
+    return buf;
 }
 
+#if EMBAJAX_COMPRESSION_WINDOW > 0
+//////////////////////// EmbAJAXCompressor ///////////////////////////////////
+
+static_assert(((EMBAJAX_COMPRESSION_WINDOW & (EMBAJAX_COMPRESSION_WINDOW - 1)) == 0) && (EMBAJAX_COMPRESSION_WINDOW >= 256) && (EMBAJAX_COMPRESSION_WINDOW <= 16384),
+              "EMBAJAX_COMPRESSION_WINDOW must be a power of two between 256 and 16384");
+static_assert(EMBAJAX_COMPRESSION_THRESHOLD <= EMBAJAX_COMPRESSION_WINDOW, "EMBAJAX_COMPRESSION_THRESHOLD must not be larger than EMBAJAX_COMPRESSION_WINDOW");
+
+#define EMBAJAX_LZ_ESCAPE 1
+#define EMBAJAX_LZ_MINLEN 5
+#define EMBAJAX_LZ_MAXLEN 64
+
+void EmbAJAXCompressor::beginCompression(bool enable) {
+    _mode = enable ? Collecting : Off;
+    _pos = _end = 0;
+    _outlen = 0;
+    // NOTE: No need to clear the hash table. Stale entries are either out of range, or simply fail to match.
+}
+
+bool EmbAJAXCompressor::compressContent(const char* content) {
+    if (_mode == Off) return false;
+    while (*content) {
+        if (_mode == Compressing && (uint16_t) (_end - _pos) >= EMBAJAX_LZ_MAXLEN) step();
+        _window[_end++ & (EMBAJAX_COMPRESSION_WINDOW - 1)] = *content++;
+        if (_mode == Collecting && _end >= EMBAJAX_COMPRESSION_THRESHOLD) {
+            // Large response: From here on, compress
+            _mode = Compressing;
+            put(EMBAJAX_LZ_ESCAPE);
+            while ((uint16_t) (_end - _pos) >= EMBAJAX_LZ_MAXLEN) step();
+        }
+    }
+    return true;
+}
+
+void EmbAJAXCompressor::finishCompression() {
+    if (_mode == Collecting) {  // Small response: Send as is
+        for (uint16_t i = 0; i < _end; ++i) put(at(i));
+    } else {
+        while (_pos != _end) step();
+    }
+    flush();
+    _mode = Off;
+}
+
+uint16_t EmbAJAXCompressor::hashAt(uint16_t pos) const {
+    uint16_t h = at(pos);
+    h = h * 33 + at(pos + 1);
+    h = h * 33 + at(pos + 2);
+    h = h * 33 + at(pos + 3);
+    return h & (EMBAJAX_COMPRESSION_WINDOW / 8 - 1);
+}
+
+void EmbAJAXCompressor::step() {
+    const uint16_t lookahead = _end - _pos;
+    uint16_t len = 0;
+    uint16_t dist = 0;
+    if (lookahead >= EMBAJAX_LZ_MINLEN) {
+        uint16_t h = hashAt(_pos);
+        uint16_t candidate = _hash[h];
+        _hash[h] = _pos;
+        dist = _pos - candidate;
+        // The candidate must still be inside the window (and must not be the current position, or a stale one from the future)
+        if (dist > 0 && dist < 0x4000 && (uint16_t) (_end - candidate) <= EMBAJAX_COMPRESSION_WINDOW) {
+            const uint16_t maxlen = min(lookahead, (uint16_t) EMBAJAX_LZ_MAXLEN);
+            while (len < maxlen && at(candidate + len) == at(_pos + len)) ++len;
+        }
+    }
+
+    if (len >= EMBAJAX_LZ_MINLEN) {
+        put(EMBAJAX_LZ_ESCAPE);
+        put(0x80 | (len - EMBAJAX_LZ_MINLEN));
+        put(0x80 | (dist >> 7));
+        put(0x80 | (dist & 0x7F));
+        for (uint16_t i = 1; i < len; ++i) {
+            if ((uint16_t) (_end - (_pos + i)) >= 4) _hash[hashAt(_pos + i)] = _pos + i;
+        }
+        _pos += len;
+    } else {
+        const uint8_t c = at(_pos++);
+        if (c == EMBAJAX_LZ_ESCAPE) put(EMBAJAX_LZ_ESCAPE);
+        put(c);
+    }
+}
+
+void EmbAJAXCompressor::put(uint8_t c) {
+    _out[_outlen++] = c;
+    if (_outlen >= sizeof(_out) - 1) flush();
+}
+
+void EmbAJAXCompressor::flush() {
+    if (!_outlen) return;
+    _out[_outlen] = '\0';
+    printCompressed(_out);
+    _outlen = 0;
+}
+#endif
+
 //////////////////////// EmbAJAXConnectionIndicator ///////////////////////
 
 void EmbAJAXConnectionIndicator::print() const {
-    _driver->printFormatted("<div class=\"EmbAJAXStatus\"><span>", PLAIN_STRING(_content_ok), "</span><span>", PLAIN_STRING(_content_fail), "</span><script>\n"
-                           "window.ardujaxsh = { 'div': document.scripts[document.scripts.length-1].parentNode,\n"
-                           "'good': 0,\n"
-                           "'tid': null,\n"
-                           "'toggle': function(on) { this.div.children[on].style.display = 'none'; this.div.children[1-on].style.display = 'inline'; this.good = on; },\n"
-                           "'in': function() { clearTimeout(this.tid); this.tid = window.setTimeout(this.toggle.bind(this, 0), 5000); if(!this.good) {this.toggle(1);} }\n"
-                           "};\nwindow.ardujaxsh.in();\n</script></div>");
+    _driver->printFormatted("<div class=\"EmbAJAXStatus\"><span>", PLAIN_STRING(_content_ok), "</span><span>", PLAIN_STRING(_content_fail), "</span><script>" EMBAJAX_NL
+                           "window.ardujaxsh = { 'div': document.scripts[document.scripts.length-1].parentNode," EMBAJAX_NL
+                               "'good': 0," EMBAJAX_NL
+                               "'tid': null," EMBAJAX_NL
+                               "'toggle': function(on) { this.div.children[on].style.display = 'none'; this.div.children[1-on].style.display = 'inline'; this.good = on; }," EMBAJAX_NL
+                               "'in': function() { clearTimeout(this.tid); this.tid = window.setTimeout(this.toggle.bind(this, 0), Math.max(5000, 2 * poll_interval)); if(!this.good) {this.toggle(1);} }" EMBAJAX_NL
+                           "};" EMBAJAX_NL
+                           "window.ardujaxsh.in();" EMBAJAX_NL
+                           "</script></div>");
 }
 
 ////////////////////////////// EmbAJAXElement /////////////////////////////
 
-/** @param id: The id for the element. Note that the string is not copied. Do not use a temporary string in this place. Also, do keep it short. */
-EmbAJAXElement::EmbAJAXElement(const char* id) : EmbAJAXBase() {
-    _id = id;
-    _flags = 1 << EmbAJAXBase::Visibility | 1 << EmbAJAXBase::Enabledness;
-    revision = 1;
-}
-
 bool EmbAJAXElement::sendUpdates(uint16_t since, bool first) {
-    if (!changed(since)) return false;
-    if (!first) _driver->printContent(",\n");
-    _driver->printFormatted("{\n\"id\": ", JS_QUOTED_STRING(_id), ",\n\"changes\": [");
+    EMBAJAX_TRACE_SPAN("sendUpdates", this);
+    bool due = true;
+    if (_update_classes) {
+        const uint8_t update_class = updateClass();
+        due = _update_classes->due & (1 << update_class);
+        if (update_class != Realtime) since = _update_classes->since[update_class];
+    }
+    bool catch_up = false;  // element has just scrolled into view of the client: send in full
+#if EMBAJAX_VIEWPORT_UPDATES
+    if (_client_view) {
+        const uint8_t bit = EmbAJAXClientView::bit(id());
+        if (EmbAJAXClientView::test(_client_view->entered, bit)) due = catch_up = true;
+        else if (_client_view->outOfView(bit)) due = false;
+    }
+#endif
+    EmbAJAXUpdatePass *pass = _update_pass;
+    if (pass) {
+        if (basicProperty(EmbAJAXBase::HighPriority) != pass->high_priority) return false;
+        if (!pass->high_priority) {
+            const uint16_t index = pass->index++;  // NOTE: counting elements that are not due, too, so indices are stable across polls
+            if (!due || pass->hidden || pass->stopped_at != 0xFFFF) return false;
+            if (index < pass->resume_index) since = pass->resume_revision;  // NOTE: also for catch_up, as these have been sent in full, already
+            else if (catch_up) since = 0;
+            refresh();
+            if (!changed(since)) return false;
+            const size_t size = updateSize();
+            if (size > pass->budget && pass->sent) {
+                pass->stopped_at = index;
+                return false;
+            }
+            pass->sent = true;
+            pass->budget -= min(size, (size_t) pass->budget);
+        } else {
+            if (!due || pass->hidden) return false;
+            if (pass->resume_index) since = pass->resume_revision;  // high priority changes are always sent in full
+            else if (catch_up) since = 0;
+            refresh();
+            if (!changed(since)) return false;
+            pass->budget -= min(updateSize(), (size_t) pass->budget);
+        }
+    } else {
+        if (!due) return false;
+        if (catch_up) since = 0;
+        refresh();
+        if (!changed(since)) return false;
+    }
+    if (!first) _driver->printContent("," EMBAJAX_NL);
+    _driver->printFormatted("{" EMBAJAX_NL "\"id\":", JS_QUOTED_STRING(id()), "," EMBAJAX_NL "\"changes\":[");
     uint8_t i = 0;
     while (true) {
         const char* pid = valueProperty(i);
@@ -176,18 +410,35 @@ bool EmbAJAXElement::sendUpdates(uint16_t since, bool first) {
         if (!pid || !pval) break;
 
         if (i != 0) _driver->printContent(",");
-        _driver->printFormatted("[", JS_QUOTED_STRING(pid), ", ");
+        _driver->printFormatted("[", JS_QUOTED_STRING(pid), ",");
         _driver->printFiltered(pval, EmbAJAXOutputDriverBase::JSQuoted, valueNeedsEscaping(i));
         _driver->printContent("]");
 
         ++i;
     }
-    _driver->printContent("]\n}");
+    _driver->printContent("]" EMBAJAX_NL "}");
     return true;
 }
 
+size_t EmbAJAXElement::updateSize() const {
+    size_t size = sizeof("," EMBAJAX_NL "{" EMBAJAX_NL "\"id\":" "," EMBAJAX_NL "\"changes\":[" "]" EMBAJAX_NL "}") - 1;
+    size += EmbAJAXOutputDriverBase::filteredLength(id(), EmbAJAXOutputDriverBase::JSQuoted, false);
+    uint8_t i = 0;
+    while (true) {
+        const char* pid = valueProperty(i);
+        const char* pval = value(i);
+        if (!pid || !pval) break;
+
+        size += sizeof("," "[" "," "]") - 1;
+        size += EmbAJAXOutputDriverBase::filteredLength(pid, EmbAJAXOutputDriverBase::JSQuoted, false);
+        size += EmbAJAXOutputDriverBase::filteredLength(pval, EmbAJAXOutputDriverBase::JSQuoted, valueNeedsEscaping(i));
+        ++i;
+    }
+    return size;
+}
+
 void EmbAJAXElement::setBasicProperty(uint8_t num, bool status) {
-    uint8_t status_bit = 1 << num;
+    uint16_t status_bit = 1 << num;
     if (status == (bool) (_flags & status_bit)) return;
     if (status) _flags |= status_bit;
     else _flags -= _flags & status_bit;
@@ -196,37 +447,160 @@ void EmbAJAXElement::setBasicProperty(uint8_t num, bool status) {
 
 void EmbAJAXElement::setChanged() {
     revision = _driver->setChanged();
+    if (this != _refreshing) _other_change = true;
+}
+
+void EmbAJAXElement::refresh() {
+    _refreshing = this;
+    refreshValue();
+    _refreshing = 0;
 }
 
 bool EmbAJAXElement::changed(uint16_t since) {
     if ((revision + 40000) < since) revision = since + 1;    // basic overflow protection. Results in sending _all_ states at least every 40000 request cycles
+    if (!_held_back) _held_back = EmbAJAXTransaction::open();  // a transaction begun while sending updates holds back the rest of the response, too
+    if (_held_back && revision > _driver->revision()) return false;  // not yet published, see EmbAJAXTransaction
     return (revision > since);
 }
 
-void EmbAJAXElement::printTextInput(size_t SIZE, const char* _value) const {
+//////////////////////// EmbAJAXSharedCounter ////////////////////////////////////
+
+#if defined (ESP32)
+static portMUX_TYPE shared_counter_lock = portMUX_INITIALIZER_UNLOCKED;
+#define EMBAJAX_ENTER_CRITICAL() portENTER_CRITICAL(&shared_counter_lock)
+#define EMBAJAX_EXIT_CRITICAL() portEXIT_CRITICAL(&shared_counter_lock)
+#else
+#define EMBAJAX_ENTER_CRITICAL() noInterrupts()
+#define EMBAJAX_EXIT_CRITICAL() interrupts()
+#endif
+
+void EmbAJAXSharedCounter::increment() {
+    EMBAJAX_ENTER_CRITICAL();
+    ++_value;
+    EMBAJAX_EXIT_CRITICAL();
+}
+
+void EmbAJAXSharedCounter::decrement() {
+    EMBAJAX_ENTER_CRITICAL();
+    if (_value) --_value;
+    EMBAJAX_EXIT_CRITICAL();
+}
+
+//////////////////////// EmbAJAXThrottle ////////////////////////////////////
+
+bool EmbAJAXThrottle::accept(int16_t a, int16_t b, int16_t c) {
+    const int16_t value[3] = { a, b, c };
+    const uint32_t now = millis();
+    bool changed = false;   // differs from the value sent
+    bool moved = false;     // differs from the value held back
+    bool outside = false;
+    for (uint8_t i = 0; i < 3; ++i) {
+        const uint16_t delta = abs(value[i] - _sent[i]);
+        const uint16_t limit = max(_deadband, (uint16_t) ((uint32_t) abs(_sent[i]) * _deadband_percent / 100));
+        if (delta) changed = true;
+        if (delta > limit) outside = true;
+        if (value[i] != _held[i]) moved = true;
+        _held[i] = value[i];
+    }
+    if (!changed) {  // back at the value sent: nothing left to send
+        setPending(None);
+        return false;
+    }
+    // NOTE: Setting the same value again (e.g. on each run of loop()) must not restart the settle time
+    if (moved || _pending == None) _last_change = now;
+    if (outside && (now - _last_sent >= _min_interval)) {
+        sync(a, b, c);
+        _last_sent = now;
+        return true;
+    }
+    setPending(outside ? OutsideDeadband : WithinDeadband);
+    return false;
+}
+
+bool EmbAJAXThrottle::due() {
+    if (_pending == None) return false;
+    const uint32_t now = millis();
+    if (now - _last_sent < _min_interval) return false;
+    if (_pending == WithinDeadband && (now - _last_change < _settle_time)) return false;
+    sync(_held[0], _held[1], _held[2]);
+    _last_sent = now;
+    return true;
+}
+
+void EmbAJAXThrottle::sync(int16_t a, int16_t b, int16_t c) {
+    _sent[0] = a;
+    _sent[1] = b;
+    _sent[2] = c;
+    setPending(None);
+}
+
+void EmbAJAXThrottle::setPending(Pending pending) {
+    if ((pending == None) != (_pending == None)) {
+        if (pending == None) _num_pending.decrement();
+        else _num_pending.increment();
+    }
+    _pending = pending;
+}
+
+//////////////////////// EmbAJAXTextInput ////////////////////////////////////
+
+void EmbAJAXTextInputBase::print(size_t SIZE, const char* _value) const {
     _driver->printFormatted("<input type=\"text\" id=", HTML_QUOTED_STRING(_id), " maxLength=", INTEGER_VALUE(SIZE-1),
                             " size=", INTEGER_VALUE(min(max((size_t) SIZE, (size_t) 11), (size_t) 41) - 1), // Arbitray limit for rendered width of text fields: 10..40 chars
                             " value=", HTML_QUOTED_STRING(_value), " onInput=\"doRequest(this.id, this.value);\"/>");
 }
 
+const char* EmbAJAXTextInputBase::valueProperty(uint8_t which) const {
+    if (which == EmbAJAXBase::Value) return "value";
+    return EmbAJAXElement::valueProperty(which);
+}
+
+void EmbAJAXTextInputBase::setValue(char* _value, size_t SIZE, const char* value) {
+    strncpy(_value, value, SIZE);
+    _value[SIZE-1] = '\0';
+    setChanged();
+}
+
+void EmbAJAXTextInputBase::updateFromDriverArg(char* value, char* buf, size_t size, const char* argname) {
+    if (!_change_callback) {
+        _driver->getArg(argname, value, size);
+        return;
+    }
+    strcpy(buf, value);
+    _driver->getArg(argname, value, size);
+    if (strcmp(buf, value) != 0) _change_callback(this, buf, value);
+}
+
 //////////////////////// EmbAJAXContainer ////////////////////////////////////
 
 void EmbAJAXBase::printChildren(EmbAJAXBase** _children, size_t NUM) const {
+    EMBAJAX_TRACE_SPAN("printChildren", 0);
     for (size_t i = 0; i < NUM; ++i) {
+        EMBAJAX_TRACE_SPAN("print", _children[i]->toElement());
         _children[i]->print();
     }
 }
 
-bool EmbAJAXBase::sendUpdates(EmbAJAXBase** _children, size_t NUM, uint16_t since, bool first) {
-    for (size_t i = 0; i < NUM; ++i) {
+void EmbAJAXContainerBase::print() const {
+    printChildren(_children, _num);
+}
+
+bool EmbAJAXContainerBase::sendUpdates(uint16_t since, bool first) {
+    for (size_t i = 0; i < _num; ++i) {
         bool sent = _children[i]->sendUpdates(since, first);
         if (sent) first = false;
     }
     return !first;
 }
 
-EmbAJAXElement* EmbAJAXBase::findChild(EmbAJAXBase** _children, size_t NUM, const char*id) const {
-    for (size_t i = 0; i < NUM; ++i) {
+void EmbAJAXContainerBase::setBasicProperty(uint8_t num, bool status) {
+    for (size_t i = 0; i < _num; ++i) {
+        _children[i]->setBasicProperty(num, status);
+    }
+}
+
+EmbAJAXElement* EmbAJAXContainerBase::findChild(const char*id) const {
+    for (size_t i = 0; i < _num; ++i) {
         EmbAJAXElement* child = _children[i]->toElement();
         if (child) {
             if (strcmp(id, child->id()) == 0) return child;
@@ -237,12 +611,49 @@ EmbAJAXElement* EmbAJAXBase::findChild(EmbAJAXBase** _children, size_t NUM, cons
     return 0;
 }
 
+//////////////////////// EmbAJAXHideableContainer ////////////////////////////
+
+void EmbAJAXHideableContainerBase::print() const {
+    _driver->printFormatted("<div id=", HTML_QUOTED_STRING(_id), ">");
+    _childlist.print();
+    _driver->printContent("</div>");
+}
+
+EmbAJAXElement* EmbAJAXHideableContainerBase::findChild(const char* id) const {
+    return _childlist.findChild(id);
+}
+
+bool EmbAJAXHideableContainerBase::sendUpdates(uint16_t since, bool first) {
+    bool sent = EmbAJAXElement::sendUpdates(since, first);
+    if (!basicProperty(EmbAJAXBase::Visibility)) {
+        // Changes to the children are held back, while hidden (see setBasicProperty()). They still need to be counted, however, so positions
+        // for resuming incomplete responses stay valid.
+        EmbAJAXUpdatePass *pass = _update_pass;
+        if (pass) {
+            const bool hidden = pass->hidden;
+            pass->hidden = true;
+            _childlist.sendUpdates(since, false);
+            pass->hidden = hidden;
+        }
+        return sent;
+    }
+    bool sent2 = _childlist.sendUpdates(since, first && !sent);
+    return sent || sent2;
+}
+
+void EmbAJAXHideableContainerBase::setBasicProperty(uint8_t num, bool status) {
+    // When shown again, mark all children as changed, so that any changes held back while hidden are sent (along with the now visible children).
+    if (num == EmbAJAXBase::Visibility && status && !basicProperty(num)) _childlist.setBasicProperty(num, false);
+    EmbAJAXElement::setBasicProperty(num, status);
+    _childlist.setBasicProperty(num, status);
+}
+
 //////////////////////// EmbAJAXMutableSpan /////////////////////////////
 
 void EmbAJAXMutableSpan::print() const {
     _driver->printFormatted("<span id=", HTML_QUOTED_STRING(_id), ">");
     if (_value) _driver->printFiltered(_value, EmbAJAXOutputDriverBase::NotQuoted, valueNeedsEscaping());
-    _driver->printContent("</span>\n");
+    _driver->printContent("</span>" EMBAJAX_NL);
 }
 
 const char* EmbAJAXMutableSpan::value(uint8_t which) const {
@@ -268,14 +679,18 @@ void EmbAJAXMutableSpan::setValue(const char* value, bool allowHTML) {
     setChanged();
 }
 
-//////////////////////// EmbAJAXSlider /////////////////////////////
+void EmbAJAXMutableSpan::setReading(const char* text, int16_t reading) {
+    _value = text;
+    if (basicProperty(EmbAJAXBase::HTMLAllowed)) setBasicProperty(EmbAJAXBase::HTMLAllowed, false);
+    if (!_throttle || _throttle->accept(reading)) setChanged();
+}
 
-EmbAJAXSlider::EmbAJAXSlider(const char* id, int16_t min, int16_t max, int16_t initial) : EmbAJAXElement(id) {
-    _value = initial;
-    _min = min;
-    _max = max;
+void EmbAJAXMutableSpan::refreshValue() {
+    if (_throttle && _throttle->due()) setChanged();
 }
 
+//////////////////////// EmbAJAXSlider /////////////////////////////
+
 void EmbAJAXSlider::print() const {
     _driver->printFormatted("<input type=\"range\" id=", HTML_QUOTED_STRING(_id), " min=", INTEGER_VALUE(_min), " max=", INTEGER_VALUE(_max), " value=", INTEGER_VALUE(_value),
                            " oninput=\"doRequest(this.id, this.value);\" onchange=\"oninput();\"/>");
@@ -294,22 +709,23 @@ const char* EmbAJAXSlider::valueProperty(uint8_t which) const {
 void EmbAJAXSlider::updateFromDriverArg(const char* argname) {
     char buf[16];
     _driver->getArg(argname, buf, 16);
+    const int16_t old_value = _value;
     _value = atoi(buf);
+    if (_throttle) _throttle->sync(_value);
+    if (_change_callback && _value != old_value) _change_callback(this, old_value, _value);
 }
 
 void EmbAJAXSlider::setValue(int16_t value) {
     _value = value;
-    setChanged();
+    if (!_throttle || _throttle->accept(value)) setChanged();
 }
 
-//////////////////////// EmbAJAXColorPicker /////////////////////////
-
-EmbAJAXColorPicker::EmbAJAXColorPicker(const char* id, uint8_t r, uint8_t g, uint8_t b) : EmbAJAXElement(id) {
-    _r = r;
-    _g = g;
-    _b = b;
+void EmbAJAXSlider::refreshValue() {
+    if (_throttle && _throttle->due()) setChanged();
 }
 
+//////////////////////// EmbAJAXColorPicker /////////////////////////
+
 void EmbAJAXColorPicker::print() const {
     _driver->printFormatted("<input type=\"color\" id=", HTML_QUOTED_STRING(_id), " value=", HTML_QUOTED_STRING(value()),
                            " oninput=\"doRequest(this.id, this.value);\" onchange=\"oninput();\"/>");
@@ -341,7 +757,11 @@ void EmbAJAXColorPicker::setColor(uint8_t r, uint8_t g, uint8_t b) {
     _r = r;
     _g = g;
     _b = b;
-    setChanged();
+    if (!_throttle || _throttle->accept(r, g, b)) setChanged();
+}
+
+void EmbAJAXColorPicker::refreshValue() {
+    if (_throttle && _throttle->due()) setChanged();
 }
 
 uint8_t EmbAJAXColorPicker::red() const {
@@ -370,19 +790,16 @@ void EmbAJAXColorPicker::updateFromDriverArg(const char* argname)  {
     if ((strlen (buf) != 7) || (buf[0] != '#')) { // format error. Set changed in order to sync back to client
         setChanged();
     }
+    const uint32_t old_rgb = rgb();
     _r = (single_hex_atoi(buf[1]) << 4) + single_hex_atoi(buf[2]);
     _g = (single_hex_atoi(buf[3]) << 4) + single_hex_atoi(buf[4]);
     _b = (single_hex_atoi(buf[5]) << 4) + single_hex_atoi(buf[6]);
+    if (_throttle) _throttle->sync(_r, _g, _b);
+    if (_change_callback && rgb() != old_rgb) _change_callback(this, old_rgb, rgb());
 }
 
 //////////////////////// EmbAJAXPushButton /////////////////////////////
 
-EmbAJAXPushButton::EmbAJAXPushButton(const char* id, const char* label, void (*callback)(EmbAJAXPushButton*)) : EmbAJAXElement (id) {
-    _label = label;
-    _callback = callback;
-    _flags |= (1 << EmbAJAXBase::HTMLAllowed); // like setBasicProperty(EmbAJAXBase::HTMLAllowed, true); but without changing value or presuming a driver instance
-}
-
 void EmbAJAXPushButton::print() const {
     _driver->printFormatted("<button type=\"button\" id=", HTML_QUOTED_STRING(_id),
                            " onClick=\"doRequest(this.id, 'p', 2);\">"); // 2 -> not mergeable -> so we can count individual presses, even if they happen fast
@@ -417,19 +834,14 @@ void EmbAJAXPushButton::updateFromDriverArg(const char* argname) {
 
 //////////////////////// EmbAJAXḾomentaryButton /////////////////////////////
 
-EmbAJAXMomentaryButton::EmbAJAXMomentaryButton(const char* id, const char* label, uint16_t timeout, void (*callback)(EmbAJAXPushButton*)) : EmbAJAXPushButton(id, label, callback) {
-    latest_ping = 0;
-    _timeout = timeout;
-}
-
 void EmbAJAXMomentaryButton::print() const {
     _driver->printFormatted("<button type=\"button\" id=", HTML_QUOTED_STRING(_id), ">");
     _driver->printFiltered(_label, EmbAJAXOutputDriverBase::NotQuoted, valueNeedsEscaping());
     _driver->printFormatted("</button>"
-                          "<script>\n"
-                          "{let btn=document.getElementById(", JS_QUOTED_STRING(_id), ");\n"
-                          "btn.onmousedown = btn.ontouchstart = function() { clearInterval(this.pinger); this.pinger=setInterval(function() {doRequest(this.id, 'p');}.bind(this),", INTEGER_VALUE((int) (_timeout / 1.5)), "); doRequest(this.id, 'p'); return false; };\n"
-                          "btn.onmouseup = btn.ontouchend = btn.onmouseleave = function() { clearInterval(this.pinger); doRequest(this.id, 'r'); return false;};}\n"
+                          "<script>" EMBAJAX_NL
+                          "{let btn=document.getElementById(", JS_QUOTED_STRING(_id), ");" EMBAJAX_NL
+                          "btn.onmousedown = btn.ontouchstart = function() { clearInterval(this.pinger); this.pinger=setInterval(function() {doRequest(this.id, 'p');}.bind(this),", INTEGER_VALUE((int) (_timeout / 1.5)), "); doRequest(this.id, 'p'); return false; };" EMBAJAX_NL
+                          "btn.onmouseup = btn.ontouchend = btn.onmouseleave = function() { clearInterval(this.pinger); doRequest(this.id, 'r'); return false;};}" EMBAJAX_NL
                           "</script>");
 }
 
@@ -453,22 +865,16 @@ void EmbAJAXMomentaryButton::updateFromDriverArg(const char* argname) {
 
 //////////////////////// EmbAJAXCheckButton /////////////////////////////
 
-EmbAJAXCheckButton::EmbAJAXCheckButton(const char* id, const char* label, bool checked) : EmbAJAXElement(id) {
-    _label = label;
-    _checked = checked;
-    radiogroup = nullptr;
-}
-
 void EmbAJAXCheckButton::print() const {
     _driver->printFormatted("<span class=", HTML_QUOTED_STRING(radiogroup ? "radio" : "checkbox"), ">" // <input> and <label> inside a common span to support hiding, better.
                                                                                                        // Also, assign a class to the surrounding span to ease styling via CSS.
-                           "<input id=", HTML_QUOTED_STRING(_id), " type=", HTML_QUOTED_STRING(radiogroup ? "radio" : "checkbox"),
+                           "<input id=", HTML_QUOTED_STRING(id()), " type=", HTML_QUOTED_STRING(radiogroup ? "radio" : "checkbox"),
                            " value=\"t\" onChange=\"doRequest(this.id, this.checked ? 't' : 'f');\"");
     if (radiogroup) _driver->printAttribute("name", radiogroup->_name);
     if (_checked) _driver->printContent(" checked=\"true\"");
     // Note: Internal <span> element for more flexbility in styling the control
 	if (_label) {
-		_driver->printFormatted("/><label for=", HTML_QUOTED_STRING(_id), ">", PLAIN_STRING(_label), // NOTE: Not escaping _label, so user can insert HTML.
+		_driver->printFormatted("/><label for=", HTML_QUOTED_STRING(id()), ">", PLAIN_STRING(_label), // NOTE: Not escaping _label, so user can insert HTML.
 								"</label></span>");
 	} else {
 		_driver->printContent("/></span>");
@@ -483,8 +889,14 @@ const char* EmbAJAXCheckButton::value(uint8_t which) const {
 void EmbAJAXCheckButton::updateFromDriverArg(const char* argname) {
     char buf[16];
     _driver->getArg(argname, buf, 16);
+    const bool old_checked = _checked;
     _checked = (buf[0] == 't');
-    if (_checked && radiogroup) radiogroup->selectButton(this);
+    if (_change_callback && _checked != old_checked) _change_callback(this, old_checked, _checked);
+    if (_checked && radiogroup) {
+        const uint8_t old_option = radiogroup->selectedOption();
+        radiogroup->selectButton(this);
+        if (radiogroup->_change_callback && radiogroup->selectedOption() != old_option) radiogroup->_change_callback(radiogroup, old_option, radiogroup->selectedOption());
+    }
 }
 
 const char* EmbAJAXCheckButton::valueProperty(uint8_t which) const {
@@ -500,12 +912,43 @@ void EmbAJAXCheckButton::setChecked(bool checked) {
     setChanged();
 }
 
+//////////////////////// EmbAJAXRadioGroup(Base) /////////////////
+
+void EmbAJAXRadioGroupBase::initButtons(EmbAJAXCheckButton* buttons, char (*childids)[EMBAJAX_MAX_ID_LEN], const char* const* options) {
+    for (uint8_t i = 0; i < _num; ++i) {
+        char* childid = childids[i];
+        strncpy(childid, _name, EMBAJAX_MAX_ID_LEN-4);
+        childid[EMBAJAX_MAX_ID_LEN-4] = '\0';
+        itoa(i, &(childid[strlen(childid)]), 10);
+        buttons[i] = EmbAJAXCheckButton(childid, options[i], i == _current_option, this);
+        _children[i] = &buttons[i];
+    }
+}
+
+void EmbAJAXRadioGroupBase::selectOption(uint8_t num) {
+    for (uint8_t i = 0; i < _num; ++i) {
+        static_cast<EmbAJAXCheckButton*>(_children[i])->setChecked(i == num);
+    }
+    _current_option = num;  // NOTE: might be outside of range, but that's ok, signifies "none selected"
+}
+
+void EmbAJAXRadioGroupBase::selectButton(EmbAJAXCheckButton* which) {
+    _current_option = -1;
+    for (uint8_t i = 0; i < _num; ++i) {
+        if (which == _children[i]) {
+            _current_option = i;
+        } else {
+            static_cast<EmbAJAXCheckButton*>(_children[i])->setChecked(false);
+        }
+    }
+}
+
 //////////////////////// EmbAJAXOptionSelect(Base) ///////////////
 
 void EmbAJAXOptionSelectBase::print(const char* const* _labels, uint8_t NUM) const {
-    _driver->printFormatted("<select id=", HTML_QUOTED_STRING(_id), " onChange=\"doRequest(this.id, this.value)\">\n");
+    _driver->printFormatted("<select id=", HTML_QUOTED_STRING(_id), " onChange=\"doRequest(this.id, this.value)\">" EMBAJAX_NL);
     for(uint8_t i = 0; i < NUM; ++i) {
-        _driver->printFormatted("<option value=", INTEGER_VALUE(i), ">", HTML_QUOTED_STRING(_labels[i]), "</option>\n");
+        _driver->printFormatted("<option value=", INTEGER_VALUE(i), ">", HTML_QUOTED_STRING(_labels[i]), "</option>" EMBAJAX_NL);
     }
     _driver->printContent("</select>");
 }
@@ -530,95 +973,753 @@ const char* EmbAJAXOptionSelectBase::valueProperty(uint8_t which) const {
 }
 
 void EmbAJAXOptionSelectBase::updateFromDriverArg(const char* argname) {
+    const uint8_t old_option = _current_option;
     _current_option = atoi(_driver->getArg(argname, itoa_buf, ITOA_BUFLEN));
+    if (_change_callback && _current_option != old_option) _change_callback(this, old_option, _current_option);
+}
+
+#if EMBAJAX_RESPONSE_CACHE > 0
+//////////////////////// EmbAJAXResponseCache ////////////////////
+
+/** Shared cache of recently rendered update responses, see EMBAJAX_RESPONSE_CACHE. While recording, all content passing through
+ *  EmbAJAXOutputDriverBase::printContent() is copied into the cache. */
+class EmbAJAXResponseCache {
+public:
+    enum {
+        KeyLength = 8,
+        SlotSize = EMBAJAX_RESPONSE_CACHE / EMBAJAX_RESPONSE_CACHE_ENTRIES
+    };
+    /** @returns the cached response for the given page and key, or 0 */
+    const char* find(const EmbAJAXPageBase *page, const uint16_t *key) const {
+        for (uint8_t i = 0; i < EMBAJAX_RESPONSE_CACHE_ENTRIES; ++i) {
+            if (_slots[i].page == page && memcmp(_slots[i].key, key, sizeof(_slots[i].key)) == 0) return _slots[i].data;
+        }
+        return 0;
+    }
+    /** Start recording a response into the oldest slot */
+    void record(const EmbAJAXPageBase *page, const uint16_t *key) {
+        _page = page;
+        _recording = &_slots[_next];
+        _next = (_next + 1) % EMBAJAX_RESPONSE_CACHE_ENTRIES;
+        _recording->page = 0;  // Not valid until complete
+        memcpy(_recording->key, key, sizeof(_recording->key));
+        _len = 0;
+    }
+    /** Do not keep the response being recorded, e.g. as it depends on more than the revision */
+    void discard() {
+        _recording = 0;
+    }
+    void stopRecording() {
+        if (_recording) {
+            _recording->data[_len] = '\0';
+            _recording->page = _page;
+        }
+        _recording = 0;
+    }
+    /** Add a piece of content to the response being recorded, if any */
+    void append(const char *content, size_t len) {
+        if (!_recording) return;
+        if (_len + len >= SlotSize) {  // too large to cache
+            _recording = 0;
+            return;
+        }
+        memcpy(&_recording->data[_len], content, len);
+        _len += len;
+    }
+private:
+    struct Slot {
+        const EmbAJAXPageBase *page;
+        uint16_t key[KeyLength];
+        char data[SlotSize];
+    } _slots[EMBAJAX_RESPONSE_CACHE_ENTRIES] = {};
+    const EmbAJAXPageBase *_page = 0;
+    Slot *_recording = 0;
+    size_t _len = 0;
+    uint8_t _next = 0;
+};
+
+static EmbAJAXResponseCache response_cache;
+
+#endif
+
+void EmbAJAXOutputDriverBase::printContent(const char *content) {
+#if EMBAJAX_RESPONSE_CACHE > 0 || EMBAJAX_MAX_SESSIONS > 0 || EMBAJAX_METRICS
+    outputContent(content, strlen(content));
+#else
+    outputContent(content, 0);  // length is not used
+#endif
+}
+
+void EmbAJAXOutputDriverBase::outputContent(const char *content, size_t len) {
+    EMBAJAX_TRACE_SPAN("write", 0);
+#if EMBAJAX_MAX_SESSIONS > 0 || EMBAJAX_METRICS
+    _content_bytes += len;
+#endif
+#if EMBAJAX_RESPONSE_CACHE > 0
+    response_cache.append(content, len);
+#endif
+    UNUSED(len);
+    writeContent(content);
+}
+
+//////////////////////// EmbAJAXLazySpan ////////////////////////////
+
+void EmbAJAXFormatInt(char* buf, size_t size, const void* data) {
+    char num[12];
+    itoa(*(const int*) data, num, 10);
+    strncpy(buf, num, size);
 }
 
+void EmbAJAXLazySpanBase::print(const char* value) const {
+    _driver->printFormatted("<span id=", HTML_QUOTED_STRING(_id), ">", HTML_ESCAPED_STRING(value), "</span>" EMBAJAX_NL);
+}
+
+const char* EmbAJAXLazySpanBase::valueProperty(uint8_t which) const {
+    if (which == EmbAJAXBase::Value) return "innerHTML";
+    return EmbAJAXElement::valueProperty(which);
+}
+
+bool EmbAJAXLazySpanBase::valueNeedsEscaping(uint8_t which) const {
+    if (which == EmbAJAXBase::Value) return true;
+    return EmbAJAXElement::valueNeedsEscaping(which);
+}
+
+void EmbAJAXLazySpanBase::provideValue(char* value, char* buf, size_t size) {
+    if (!_provider) return;
+#if EMBAJAX_RESPONSE_CACHE > 0
+    response_cache.discard();  // The value may change without a change in revision
+#endif
+    buf[0] = '\0';
+    _provider(buf, size, _data);
+    buf[size - 1] = '\0';
+    if (strcmp(buf, value) == 0) return;
+    strcpy(value, buf);
+    setChanged();
+}
+
+//////////////////////// EmbAJAXMemory ////////////////////////////
+
+#if EMBAJAX_MEMORY
+uint32_t (*EmbAJAXMemory::_free_heap)() = 0;
+
+#if defined (__AVR__)
+extern char __heap_start;
+extern char *__brkval;
+#endif
+
+uint32_t EmbAJAXMemory::freeHeap() {
+    if (_free_heap) return _free_heap();
+#if defined (ESP8266) || defined (ESP32)
+    return ESP.getFreeHeap();
+#elif defined (ARDUINO_ARCH_RP2040)
+    return rp2040.getFreeHeap();
+#elif defined (__AVR__)
+    // space between the top of the heap and the stack
+    char top;
+    return &top - (__brkval ? __brkval : &__heap_start);
+#else
+    return 0;
+#endif
+}
+
+EmbAJAXMemoryUsage EmbAJAXMemory::_usage[NumPasses];
+uint8_t EmbAJAXMemory::_pass = NumPasses;
+uintptr_t EmbAJAXMemory::_stack_base;
+
+void EmbAJAXMemory::reset() {
+    for (uint8_t i = 0; i < NumPasses; ++i) _usage[i] = EmbAJAXMemoryUsage();
+}
+
+void EmbAJAXMemory::begin(Pass pass) {
+    char here;
+    _pass = pass;
+    _stack_base = (uintptr_t) &here;
+    EmbAJAXMemoryUsage &u = _usage[pass];
+    u.heap_free = freeHeap();
+    if (!u.passes || u.heap_free < u.heap_low) u.heap_low = u.heap_free;
+    if (u.passes < 0xFFFF) ++u.passes;
+}
+
+void EmbAJAXMemory::sample() {
+    if (_pass >= NumPasses) return;
+    char here;
+    EmbAJAXMemoryUsage &u = _usage[_pass];
+    const uint32_t heap = freeHeap();
+    if (heap < u.heap_low) u.heap_low = heap;
+    // NOTE: The stack grows downwards on all supported platforms
+    const uintptr_t depth = _stack_base > (uintptr_t) &here ? _stack_base - (uintptr_t) &here : 0;
+    if (depth > u.stack_depth) u.stack_depth = min(depth, (uintptr_t) 0xFFFF);
+}
+
+void EmbAJAXMemory::end() {
+    sample();
+    _pass = NumPasses;
+}
+#endif
+
+#if EMBAJAX_METRICS
+//////////////////////// EmbAJAXMetrics ///////////////////////////
+
+uint32_t EmbAJAXMetrics::bucketLimit(uint8_t bucket) {
+    static const uint32_t limits[Buckets - 1] = { 1000, 2000, 5000, 10000, 20000, 50000, 100000 };
+    return bucket < Buckets - 1 ? limits[bucket] : 0xFFFFFFFF;
+}
+
+void EmbAJAXMetrics::addTime(uint32_t *histogram, uint32_t *sum, uint32_t us) {
+    uint8_t bucket = 0;
+    while (us > bucketLimit(bucket)) ++bucket;
+    ++histogram[bucket];
+    *sum += us;
+}
+
+uint16_t EmbAJAXClientLatency::bucketLimit(uint8_t bucket) {
+    static const uint16_t limits[Buckets - 1] = { 10, 20, 50, 100, 200, 500, 1000 };
+    return bucket < Buckets - 1 ? limits[bucket] : 0xFFFF;
+}
+
+void EmbAJAXClientLatency::record(uint16_t round_trip_ms, uint16_t queue_wait_ms) {
+    uint8_t bucket = 0;
+    while (round_trip_ms > bucketLimit(bucket)) ++bucket;
+    ++round_trip[bucket];
+    round_trip_sum += round_trip_ms;
+    bucket = 0;
+    while (queue_wait_ms > bucketLimit(bucket)) ++bucket;
+    ++queue_wait[bucket];
+    queue_wait_sum += queue_wait_ms;
+    ++samples;
+}
+
+/** Helper for EmbAJAXMetricsPage: print an unsigned 32 bit value */
+static void printMetric(EmbAJAXOutputDriverBase *driver, uint32_t value) {
+    char buf[12];
+    driver->printContent(ultoa(value, buf, 10));
+}
+
+/** Helper for EmbAJAXMetricsPage: print a histogram as JSON */
+static void printHistogramJSON(EmbAJAXOutputDriverBase *driver, const char* name, const uint32_t *histogram, uint32_t sum) {
+    driver->printFormatted(",\"", PLAIN_STRING(name), "\":{\"le_us\":[");
+    for (uint8_t i = 0; i < EmbAJAXMetrics::Buckets - 1; ++i) {
+        if (i) driver->printContent(",");
+        printMetric(driver, EmbAJAXMetrics::bucketLimit(i));
+    }
+    driver->printContent("],\"counts\":[");
+    for (uint8_t i = 0; i < EmbAJAXMetrics::Buckets; ++i) {
+        if (i) driver->printContent(",");
+        printMetric(driver, histogram[i]);
+    }
+    driver->printContent("],\"sum_us\":");
+    printMetric(driver, sum);
+    driver->printContent("}");
+}
+
+/** Helper for EmbAJAXMetricsPage: print a histogram in Prometheus format (with cumulative buckets) */
+static void printHistogramPrometheus(EmbAJAXOutputDriverBase *driver, const char* name, const uint32_t *histogram, uint32_t sum) {
+    driver->printFormatted("# TYPE embajax_", PLAIN_STRING(name), " histogram\n");
+    uint32_t count = 0;
+    for (uint8_t i = 0; i < EmbAJAXMetrics::Buckets; ++i) {
+        count += histogram[i];
+        driver->printFormatted("embajax_", PLAIN_STRING(name), "_bucket{le=\"");
+        if (i < EmbAJAXMetrics::Buckets - 1) printMetric(driver, EmbAJAXMetrics::bucketLimit(i));
+        else driver->printContent("+Inf");
+        driver->printContent("\"} ");
+        printMetric(driver, count);
+        driver->printContent("\n");
+    }
+    driver->printFormatted("embajax_", PLAIN_STRING(name), "_sum ");
+    printMetric(driver, sum);
+    driver->printFormatted("\nembajax_", PLAIN_STRING(name), "_count ");
+    printMetric(driver, count);
+    driver->printContent("\n");
+}
+
+void EmbAJAXMetricsPage::printPage() {
+    const EmbAJAXMetrics &m = EmbAJAXBase::metrics();
+    const struct {
+        const char* name;
+        uint32_t value;
+    } counters[] = {
+        { "page_renders", m.page_renders },
+        { "polls", m.polls },
+        { "polls_rejected", m.polls_rejected },
+        { "inputs", m.inputs },
+        { "resyncs", m.resyncs },
+        { "cache_hits", m.cache_hits },
+        { "page_bytes", m.bytes_page },
+        { "update_bytes", m.bytes_update },
+        { "buffer_flushes", m.buffer_flushes }
+    };
+    EmbAJAXOutputDriverBase *driver = EmbAJAXBase::_driver;
+    if (_format == Prometheus) {
+        driver->printTypedHeader("text/plain; version=0.0.4");
+        for (uint8_t i = 0; i < sizeof(counters) / sizeof(counters[0]); ++i) {
+            driver->printFormatted("# TYPE embajax_", PLAIN_STRING(counters[i].name), " counter\nembajax_", PLAIN_STRING(counters[i].name), "_total ");
+            printMetric(driver, counters[i].value);
+            driver->printContent("\n");
+        }
+        printHistogramPrometheus(driver, "render_time_us", m.render_time, m.render_time_sum);
+        printHistogramPrometheus(driver, "request_time_us", m.request_time, m.request_time_sum);
+    } else {
+        driver->printTypedHeader("application/json");
+        for (uint8_t i = 0; i < sizeof(counters) / sizeof(counters[0]); ++i) {
+            driver->printContent(i ? "," : "{");
+            driver->printFormatted("\"", PLAIN_STRING(counters[i].name), "\":");
+            printMetric(driver, counters[i].value);
+        }
+        printHistogramJSON(driver, "render_time", m.render_time, m.render_time_sum);
+        printHistogramJSON(driver, "request_time", m.request_time, m.request_time_sum);
+        driver->printContent("}\n");
+    }
+    driver->finishContent();
+}
+#endif
+
+#if EMBAJAX_TRACE > 0
+//////////////////////// EmbAJAXTrace /////////////////////////////
+
+EmbAJAXTrace::Span EmbAJAXTrace::_spans[EMBAJAX_TRACE];
+uint16_t EmbAJAXTrace::_next = 0;
+uint16_t EmbAJAXTrace::_count = 0;
+bool EmbAJAXTrace::_suspended = false;
+
+void EmbAJAXTrace::record(const char* name, EmbAJAXElement* element, uint32_t start, uint32_t duration) {
+    if (_suspended) return;
+    Span &span = _spans[_next];
+    span.name = name;
+    span.element = element;
+    span.start = start;
+    span.duration = duration;
+    _next = (_next + 1) % EMBAJAX_TRACE;
+    if (_count < EMBAJAX_TRACE) ++_count;
+}
+
+void EmbAJAXTrace::clear() {
+    _next = 0;
+    _count = 0;
+}
+
+/** Print a string escaped for use inside a JSON string */
+static void printJSONEscaped(Print &out, const char* value) {
+    for (const char *pos = value; *pos != '\0'; ++pos) {
+        if (*pos == '"' || *pos == '\\') {
+            out.write((uint8_t) '\\');
+            out.write((uint8_t) *pos);
+        } else if ((uint8_t) *pos < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", (uint8_t) *pos);
+            out.print(buf);
+        } else {
+            out.write((uint8_t) *pos);
+        }
+    }
+}
+
+void EmbAJAXTrace::dump(Print &out) {
+    _suspended = true;
+    char num[11];
+    out.print(F("{\"traceEvents\":["));
+    for (uint16_t i = 0; i < _count; ++i) {
+        const Span &span = _spans[(_next + EMBAJAX_TRACE - _count + i) % EMBAJAX_TRACE];
+        if (i) out.print(F(","));
+        out.print(F(EMBAJAX_NL "{\"name\":\""));
+        out.print(span.name);
+        out.print(F("\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":"));
+        out.print(ultoa(span.start, num, 10));
+        out.print(F(",\"dur\":"));
+        out.print(ultoa(span.duration, num, 10));
+        if (span.element) {
+            out.print(F(",\"args\":{\"id\":\""));
+            printJSONEscaped(out, span.element->id());
+            out.print(F("\"}"));
+        }
+        out.print(F("}"));
+    }
+    out.print(F("]}" EMBAJAX_NL));
+    _suspended = false;
+}
+
+/** Internal helper for EmbAJAXTracePage: A Print writing to the output driver */
+class EmbAJAXDriverPrint : public Print {
+public:
+    EmbAJAXDriverPrint(EmbAJAXOutputDriverBase *driver) : _driver(driver) {}
+    size_t write(uint8_t c) override {
+        _buf[_len++] = c;
+        if (_len >= sizeof(_buf) - 1) commit();
+        return 1;
+    }
+    void commit() {
+        _buf[_len] = '\0';
+        _driver->printContent(_buf);
+        _len = 0;
+    }
+private:
+    EmbAJAXOutputDriverBase *_driver;
+    char _buf[64];
+    size_t _len = 0;
+};
+
+void EmbAJAXTracePage::printPage() {
+    EmbAJAXDriverPrint out(EmbAJAXBase::_driver);
+    EmbAJAXBase::_driver->printTypedHeader("application/json");
+    EmbAJAXTrace::dump(out);
+    out.commit();
+    EmbAJAXBase::_driver->finishContent();
+}
+#endif
+
 //////////////////////// EmbAJAXPage /////////////////////////////
 
+EmbAJAXClientSession* EmbAJAXPageBase::findSession(uint16_t id) {
+#if EMBAJAX_MAX_SESSIONS > 0
+    if (!id) return 0;
+    const uint32_t now = millis();
+    uint8_t slot = 0;
+    for (uint8_t i = 0; i < EMBAJAX_MAX_SESSIONS; ++i) {
+        if (_sessions[i].id == id) return &_sessions[i];
+        // else use an empty slot, or replace the least recently seen client
+        if (_sessions[slot].id && (!_sessions[i].id || (now - _sessions[i].last_request > now - _sessions[slot].last_request))) slot = i;
+    }
+    memset(&_sessions[slot], 0, sizeof(EmbAJAXClientSession));
+    _sessions[slot].id = id;
+    return &_sessions[slot];
+#else
+    UNUSED(id);
+    return 0;
+#endif
+}
+
+void EmbAJAXPageBase::updateSession(EmbAJAXClientSession *session, uint16_t revision, uint32_t bytes_sent) {
+    const uint32_t now = millis();
+    const uint16_t elapsed = min(now - session->last_request, (uint32_t) 0xFFFF);
+    if (session->requests == 1) session->interval = elapsed;
+    else if (session->requests > 1) session->interval = ((uint32_t) session->interval * 3 + elapsed) / 4;
+    if (session->requests < 0xFFFF) ++session->requests;
+    session->last_request = now;
+    session->revision = revision;
+    session->bytes_sent += bytes_sent;
+}
+
+uint8_t EmbAJAXPageBase::activeClients(uint32_t latency_ms) const {
+    uint8_t count = 0;
+#if EMBAJAX_MAX_SESSIONS > 0
+    const uint32_t now = millis();
+    for (uint8_t i = 0; i < EMBAJAX_MAX_SESSIONS; ++i) {
+        if (_sessions[i].requests && (now - _sessions[i].last_request < latency_ms)) ++count;
+    }
+#else
+    UNUSED(latency_ms);
+#endif
+    return count;
+}
+
+const EmbAJAXClientSession* EmbAJAXPageBase::clientSession(uint8_t slot) const {
+#if EMBAJAX_MAX_SESSIONS > 0
+    if (slot < EMBAJAX_MAX_SESSIONS && _sessions[slot].requests) return &_sessions[slot];
+#else
+    UNUSED(slot);
+#endif
+    return 0;
+}
+
+uint16_t EmbAJAXPageBase::clientLag(const EmbAJAXClientSession *session) const {
+    return EmbAJAXBase::_driver->revision() - session->revision;
+}
+
+void EmbAJAXPageBase::blockClient(uint8_t slot, bool blocked) {
+#if EMBAJAX_MAX_SESSIONS > 0
+    if (slot < EMBAJAX_MAX_SESSIONS) _sessions[slot].blocked = blocked;
+#else
+    UNUSED(slot);
+    UNUSED(blocked);
+#endif
+}
+
+uint16_t EmbAJAXPageBase::admitPoll(const EmbAJAXClientSession *session) {
+    const uint32_t now = millis();
+    if (session) {
+        if (session->blocked) return 30000;
+        if (_min_client_interval && session->requests) {
+            const uint32_t elapsed = now - session->last_request;
+            if (elapsed < _min_client_interval) return _min_client_interval - elapsed;
+        }
+    }
+    if (_max_polls) {
+        if (now - _poll_window >= 1000) {
+            _poll_window = now;
+            _polls = 0;
+        }
+        if (_polls >= _max_polls) return 1000 - (now - _poll_window);
+        ++_polls;
+    }
+    return 0;
+}
+
 void EmbAJAXBase::printPage(EmbAJAXBase** _children, size_t NUM, const char* _title, const char* _header_add, uint16_t _min_interval) const {
+    EMBAJAX_TRACE_SPAN("printPage", 0);
 #if EMBAJAX_DEBUG > 2
     time_t start = millis();
 #endif
-    _driver->printHeader(true);
-    _driver->printFormatted("<!DOCTYPE html>\n<HTML><HEAD><TITLE>", PLAIN_STRING(_title), "</TITLE>\n<SCRIPT>\n"
+    printPageHeader(_title, _header_add, _min_interval);
+    printChildren(_children, NUM);
+    printPageFooter();
+#if EMBAJAX_DEBUG > 2
+    auto diff = millis() - start;
+    Serial.print("Page rendered in ");
+    Serial.print(diff);
+    Serial.println("ms");
+#endif
+}
 
-                            "var serverrevision = 0;\n"
-                            "var request_queue = [];\n"   // requests waiting to be sent
+#if EMBAJAX_METRICS
+static uint32_t page_bytes;
+static uint32_t page_start;
+#endif
+
+void EmbAJAXBase::printPageHeader(const char* _title, const char* _header_add, uint16_t _min_interval) const {
+#if EMBAJAX_MEMORY
+    EmbAJAXMemory::begin(EmbAJAXMemory::PrintPage);
+#endif
+#if EMBAJAX_METRICS
+    page_start = micros();
+    page_bytes = _driver->contentBytes();
+#endif
+    _driver->printHeader(true);
+    _driver->printFormatted("<!DOCTYPE html>" EMBAJAX_NL "<HTML><HEAD><TITLE>", PLAIN_STRING(_title), "</TITLE>" EMBAJAX_NL "<SCRIPT>" EMBAJAX_NL
+
+                            "var serverrevision = 0;" EMBAJAX_NL
+                            "var resume_at = '';" EMBAJAX_NL       // set, if the previous response was incomplete
+                            "var class_revs = [0, 0];" EMBAJAX_NL  // per update class (but Realtime): revision, and time of the latest sync. See EmbAJAXElement::setUpdateClass()
+                            "var class_times = [0, 0];" EMBAJAX_NL
+                            "var client_id = Math.floor(Math.random() * 65535) + 1;" EMBAJAX_NL  // see EmbAJAXPageBase::setAdmissionLimits()
+                            "var retry_at = 0;" EMBAJAX_NL         // server asked us not to poll before this time
+                            "var request_queue = [];" EMBAJAX_NL   // requests waiting to be sent
                             // message types: 1: regular: request may be overridden by subsequent value changes on the same id - merge if in queue
                             //                2: semi-distinct: request may override type 1 requests for the same id, but will never be overridden (button clicks)
                             //                3: fully-distinct: request may not be merged with other requests of the same id at all
-                            "function doRequest(id, value, mtype=1) {\n"
-                            "    var req = {id: id, value: value, mtype: mtype};\n"
-                            "    const i = request_queue.findIndex((x) => (x.id == id && x.mtype == 1));\n"
-                            "    if (i >= 0 && (mtype < 3)) request_queue[i] = req;\n"
-                            "    else request_queue.push(req);\n"
-                            "    window.setTimeout(sendQueued, 0);\n"  // NOTE: often events will be generated twice (e.g. onInput+onChange). Wait for the second to come in, before sending
-                            "}\n"
-
-                            "var num_waiting = 0;\n"      // number of requests sent, with no reply received, yet
-                            "var prev_request = 0;\n"
-                            "function sendQueued() {\n"
-                            "    var now = new Date().getTime();\n"
-                            "    if (num_waiting > 0 || (now - prev_request < ", INTEGER_VALUE(_min_interval), ")) return;\n"
-                            "    var e = request_queue.shift();\n"
-                            "    if (!e && (now - prev_request < 1000)) return;\n"
-                            "    if (!e) e = {id: '', value: ''};\n" //Nothing in queue, but last request more than 1000 ms ago? Send a ping to query for updates
-                            "    var req = new XMLHttpRequest();\n"
-                            "    req.timeout = 10000;\n"   // probably disconnected. Don't stack up request objects forever.
-                            "    req.onload = function() {\n"
-                            "       doUpdates(JSON.parse(req.responseText));\n"
-                            "       if(window.ardujaxsh) window.ardujaxsh.in();\n"
-                            "       --num_waiting;\n"
-                            "    }\n"
-                            "    req.onerror = req.ontimeout = function() {\n" // if transmission failed, assume we are out of sync
-                            "       serverrevision = 0;\n" // this will cause the server to re-send _all_ element states on the next poll()
-                            "       --num_waiting;\n"
-                            "    };\n"
-                            "    ++num_waiting; prev_request = now;\n"
-                            "    req.open('POST', document.URL, true);\n"
-                            "    req.setRequestHeader('Content-type', 'application/x-www-form-urlencoded');\n"
-                            "    req.send('id=' + e.id + '&value=' + encodeURIComponent(e.value) + '&revision=' + serverrevision);\n"
-                            "}\n"
-                            "window.setInterval(sendQueued, ", INTEGER_VALUE(_min_interval/2+1), ");\n"
-
-                            "function doUpdates(response) {\n"
-                            "    serverrevision = response.revision;\n"
-                            "    var updates = response.updates;\n"
-                            "    for(i = 0; i < updates.length; i++) {\n"
-                            "       element = document.getElementById(updates[i].id);\n"
-                            "       changes = updates[i].changes;\n"
-                            "       for(j = 0; j < changes.length; ++j) {\n"
-                            "          var spec = changes[j][0].split('.');\n"
-                            "          var prop = element;\n"
+                            "function doRequest(id, value, mtype=1) {" EMBAJAX_NL
+                                "var req = {id: id, value: value, mtype: mtype, queued: new Date().getTime()};" EMBAJAX_NL
+                                "const i = request_queue.findIndex((x) => (x.id == id && x.mtype == 1));" EMBAJAX_NL
+                                "if (i >= 0 && (mtype < 3)) { req.queued = request_queue[i].queued; request_queue[i] = req; }" EMBAJAX_NL
+                                "else request_queue.push(req);" EMBAJAX_NL
+                                "poll_interval = 1000;" EMBAJAX_NL   // user activity: further changes are likely
+                                "window.setTimeout(sendQueued, 0);" EMBAJAX_NL  // NOTE: often events will be generated twice (e.g. onInput+onChange). Wait for the second to come in, before sending
+                            "}" EMBAJAX_NL
+
+                            "var num_waiting = 0;" EMBAJAX_NL      // number of requests sent, with no reply received, yet
+                            "var prev_request = 0;" EMBAJAX_NL
+                            "var poll_interval = 1000;" EMBAJAX_NL   // interval for polling while idle. Adjusted in doUpdates()
+#if EMBAJAX_METRICS
+                            "var latency = '';" EMBAJAX_NL  // round trip and queue wait time of the previous request, reported with the next. See EmbAJAXPageBase::clientLatency()
+#endif
+#if EMBAJAX_VIEWPORT_UPDATES
+                            "var view_state = {};" EMBAJAX_NL       // per element id: in view (or not rendered at all), or not. See EMBAJAX_VIEWPORT_UPDATES
+                            "var view_entered = [0, 0];" EMBAJAX_NL // elements scrolled into view since the latest poll. These need to catch up
+                            "function viewBit(id) {" EMBAJAX_NL      // must match EmbAJAXClientView::bit()
+                                "var h = 0;" EMBAJAX_NL
+                                "for (var i = 0; i < id.length; ++i) h = (h * 31 + id.charCodeAt(i)) & 0xFFFF;" EMBAJAX_NL
+                                "return h & 63;" EMBAJAX_NL
+                            "}" EMBAJAX_NL
+                            "function viewArgs() {" EMBAJAX_NL
+                                "var m = [0, 0, 0, 0], off = false;" EMBAJAX_NL  // in view, out of view
+                                "for (var id in view_state) {" EMBAJAX_NL
+                                   "var b = viewBit(id), o = view_state[id] ? 0 : 2;" EMBAJAX_NL
+                                   "if (o) off = true;" EMBAJAX_NL
+                                   "m[o + (b >> 5)] |= 1 << (b & 31);" EMBAJAX_NL
+                                "}" EMBAJAX_NL
+                                "if (!off && !(view_entered[0] | view_entered[1])) return '';" EMBAJAX_NL
+                                "var hex = (x) => (x >>> 0).toString(16);" EMBAJAX_NL
+                                "var r = '&view=' + m.map(hex).join('.') + '&enter=' + view_entered.map(hex).join('.');" EMBAJAX_NL
+                                "view_entered = [0, 0];" EMBAJAX_NL
+                                "return r;" EMBAJAX_NL
+                            "}" EMBAJAX_NL
+#endif
+                            "function sendQueued() {" EMBAJAX_NL
+                                "var now = new Date().getTime();" EMBAJAX_NL
+                                "if (num_waiting > 0 || (now - prev_request < ", INTEGER_VALUE(_min_interval), ")) return;" EMBAJAX_NL
+                                "var e = request_queue.shift();" EMBAJAX_NL
+                                "if (!e && (now < retry_at || now - prev_request < (document.hidden ? 30000 : poll_interval))) return;" EMBAJAX_NL
+                                "if (!e) e = {id: '', value: '', queued: now};" EMBAJAX_NL //Nothing in queue, but last request more than poll_interval ms ago? Send a ping to query for updates
+#if EMBAJAX_VIEWPORT_UPDATES
+                                "var entered = view_entered, view = e.id ? '' : viewArgs();" EMBAJAX_NL  // reported with plain polls, only
+#endif
+                                "var req = new XMLHttpRequest();" EMBAJAX_NL
+                                "req.timeout = 10000;" EMBAJAX_NL   // probably disconnected. Don't stack up request objects forever.
+                                "req.onload = function() {" EMBAJAX_NL
+#if EMBAJAX_METRICS
+                                   "latency = '&latency=' + (new Date().getTime() - now) + '.' + (now - e.queued);" EMBAJAX_NL
+#endif
+#if EMBAJAX_COMPRESSION_WINDOW > 0
+                                   "doUpdates(JSON.parse(new TextDecoder().decode(unpack(new Uint8Array(req.response)))));" EMBAJAX_NL
+#else
+                                   "doUpdates(JSON.parse(req.responseText));" EMBAJAX_NL
+#endif
+#if EMBAJAX_VIEWPORT_UPDATES
+                                   "if (resume_at || now < retry_at) { view_entered[0] |= entered[0]; view_entered[1] |= entered[1]; }" EMBAJAX_NL  // catch up not (yet) complete
+#endif
+                                   "if(window.ardujaxsh) window.ardujaxsh.in();" EMBAJAX_NL
+                                   "--num_waiting;" EMBAJAX_NL
+                                "};" EMBAJAX_NL
+                                "req.onerror = req.ontimeout = function() {" EMBAJAX_NL // if transmission failed, assume we are out of sync
+                                   "serverrevision = 0; resume_at = '';" EMBAJAX_NL // this will cause the server to re-send _all_ element states on the next poll()
+                                   "class_revs = [0, 0]; class_times = [0, 0];" EMBAJAX_NL
+                                   "--num_waiting;" EMBAJAX_NL
+                                "};" EMBAJAX_NL
+                                "++num_waiting; prev_request = now;" EMBAJAX_NL
+                                "req.open('POST', document.URL, true);" EMBAJAX_NL
+                                "req.setRequestHeader('Content-type', 'application/x-embajax');" EMBAJAX_NL   // NOTE: form encoded, but not declared as such, so the server will pass the body through, as is
+#if EMBAJAX_COMPRESSION_WINDOW > 0
+                                "req.responseType = 'arraybuffer';" EMBAJAX_NL
+#endif
+                                // NOTE: value goes last, so that a value exceeding EMBAJAX_MAX_REQUEST_LEN (with drivers that buffer the request) cuts off nothing else
+                                "req.send('id=' + e.id + '&revision=' + serverrevision + (resume_at ? '&resume=' + resume_at : '') +" EMBAJAX_NL
+                                         "'&classes=' + class_revs.map((r, c) => r + '.' + Math.min(now - class_times[c], 65000)).join(',') + '&cid=' + client_id"
+#if EMBAJAX_VIEWPORT_UPDATES
+                                         " + view"
+#endif
+#if EMBAJAX_METRICS
+                                         " + latency"
+#endif
+                                         " + '&value=' + encodeURIComponent(e.value));" EMBAJAX_NL
+#if EMBAJAX_METRICS
+                                "latency = '';" EMBAJAX_NL
+#endif
+                            "}" EMBAJAX_NL
+                            "window.setInterval(sendQueued, ", INTEGER_VALUE(_min_interval/2+1), ");" EMBAJAX_NL
+                            "document.addEventListener('visibilitychange', function() {" EMBAJAX_NL  // page shown again: poll right away
+                                "if (!document.hidden) { poll_interval = 1000; prev_request = 0; }" EMBAJAX_NL
+                            "});" EMBAJAX_NL
+
+#if EMBAJAX_COMPRESSION_WINDOW > 0
+                            "function unpack(b) {" EMBAJAX_NL   // see EmbAJAXCompressor
+                                "if (b[0] != 1) return b;" EMBAJAX_NL
+                                "var o = [];" EMBAJAX_NL
+                                "for (var i = 1; i < b.length;) {" EMBAJAX_NL
+                                   "var c = b[i++];" EMBAJAX_NL
+                                   "if (c == 1 && (c = b[i++]) > 127) {" EMBAJAX_NL
+                                      "var s = o.length - (((b[i] & 127) << 7) | (b[i+1] & 127));" EMBAJAX_NL
+                                      "i += 2;" EMBAJAX_NL
+                                      "for (var l = c - 123; l > 0; --l) o.push(o[s++]);" EMBAJAX_NL
+                                   "} else o.push(c);" EMBAJAX_NL
+                                "}" EMBAJAX_NL
+                                "return new Uint8Array(o);" EMBAJAX_NL
+                            "}" EMBAJAX_NL
+#endif
+                            "function doUpdates(response) {" EMBAJAX_NL
+                                "if (response.retry) {" EMBAJAX_NL     // server busy: back off, with some jitter, so clients do not come back all at once
+                                   "retry_at = new Date().getTime() + response.retry * (1 + Math.random());" EMBAJAX_NL
+                                   "return;" EMBAJAX_NL
+                                "}" EMBAJAX_NL
+                                "serverrevision = response.revision;" EMBAJAX_NL
+                                "resume_at = response.resume;" EMBAJAX_NL
+                                "if (resume_at) prev_request = 0;" EMBAJAX_NL  // more changes pending on the server: poll again, without waiting
+                                "for (var c = 0; c < class_revs.length; ++c) {" EMBAJAX_NL
+                                   "if (response.synced & (1 << c)) { class_revs[c] = serverrevision; class_times[c] = new Date().getTime(); }" EMBAJAX_NL
+                                "}" EMBAJAX_NL
+                                "var updates = response.updates;" EMBAJAX_NL
+                                "if (response.next_poll_ms) poll_interval = response.next_poll_ms;" EMBAJAX_NL  // server knows best
+                                "else if (updates.length) poll_interval = 1000;" EMBAJAX_NL
+                                "else poll_interval = Math.min(poll_interval * 1.5, 3000);" EMBAJAX_NL  // back off while nothing changes
+                                "for(i = 0; i < updates.length; i++) {" EMBAJAX_NL
+                                   "element = document.getElementById(updates[i].id);" EMBAJAX_NL
+                                   "changes = updates[i].changes;" EMBAJAX_NL
+                                   "for(j = 0; j < changes.length; ++j) {" EMBAJAX_NL
+                                      "var spec = changes[j][0].split('.');" EMBAJAX_NL
+                                      "var prop = element;" EMBAJAX_NL
 #if EMBAJAX_DEBUG > 2
-                            "          console.log('Received change at revision ' + serverrevision + ': ' + updates[i].id + '/' + spec + '=' + changes[j][1]);\n"
-#endif
-                            "          for(k = 0; k < (spec.length-1); ++k) {\n"   // resolve nested attributes such as style.display
-                            "              prop = prop[spec[k]];\n"
-                            "          }\n"
-                            "          prop[spec[spec.length-1]] = changes[j][1];\n"
-                            "       }\n"
-                            "    }\n"
-                            "}\n"
-
-                            "</SCRIPT>\n", PLAIN_STRING(_header_add),
-                            "</HEAD>\n<BODY><FORM autocomplete=\"off\" onSubmit=\"return false;\">\n");
+                                      "console.log('Received change at revision ' + serverrevision + ': ' + updates[i].id + '/' + spec + '=' + changes[j][1]);" EMBAJAX_NL
+#endif
+                                      "for(k = 0; k < (spec.length-1); ++k) {" EMBAJAX_NL   // resolve nested attributes such as style.display
+                                          "prop = prop[spec[k]];" EMBAJAX_NL
+                                      "}" EMBAJAX_NL
+                                      "prop[spec[spec.length-1]] = changes[j][1];" EMBAJAX_NL
+                                   "}" EMBAJAX_NL
+                                "}" EMBAJAX_NL
+                            "}" EMBAJAX_NL
+#if EMBAJAX_VIEWPORT_UPDATES
+                            "if (window.IntersectionObserver) {" EMBAJAX_NL
+                                "var view_observer = new IntersectionObserver(function(entries) {" EMBAJAX_NL
+                                   "entries.forEach(function(en) {" EMBAJAX_NL
+                                      "var r = en.boundingClientRect, id = en.target.id;" EMBAJAX_NL
+                                      "var v = en.isIntersecting || !(r.width || r.height);" EMBAJAX_NL  // elements not rendered at all (e.g. display:none) are kept up to date
+                                      "if (v && view_state[id] === false) {" EMBAJAX_NL
+                                         "var b = viewBit(id);" EMBAJAX_NL
+                                         "view_entered[b >> 5] |= 1 << (b & 31);" EMBAJAX_NL
+                                         "prev_request = 0;" EMBAJAX_NL  // catch up right away
+                                      "}" EMBAJAX_NL
+                                      "view_state[id] = v;" EMBAJAX_NL
+                                   "});" EMBAJAX_NL
+                                "});" EMBAJAX_NL
+                                "window.addEventListener('load', function() {" EMBAJAX_NL
+                                   "document.querySelectorAll('form [id]').forEach((e) => view_observer.observe(e));" EMBAJAX_NL
+                                "});" EMBAJAX_NL
+                            "}" EMBAJAX_NL
+#endif
+
+                            "</SCRIPT>" EMBAJAX_NL, PLAIN_STRING(_header_add),
+                            "</HEAD>" EMBAJAX_NL "<BODY><FORM autocomplete=\"off\" onSubmit=\"return false;\">" EMBAJAX_NL);
                             // NOTE: The nasty thing about autocomplete is that it does not trigger onChange() functions, but also the
                             // "restore latest settings after client reload" is questionable in our use-case.
 
-    printChildren(_children, NUM);
+}
 
-    _driver->printContent("\n</FORM></BODY></HTML>\n");
-#if EMBAJAX_DEBUG > 2
-    auto diff = millis() - start;
-    Serial.print("Page rendered in ");
-    Serial.print(diff);
-    Serial.println("ms");
+void EmbAJAXBase::printPageFooter() const {
+    _driver->printContent(EMBAJAX_NL "</FORM></BODY></HTML>" EMBAJAX_NL);
+    _driver->finishContent();
+#if EMBAJAX_METRICS
+    ++_metrics.page_renders;
+    _metrics.bytes_page += _driver->contentBytes() - page_bytes;
+    EmbAJAXMetrics::addTime(_metrics.render_time, &_metrics.render_time_sum, micros() - page_start);
 #endif
+#if EMBAJAX_MEMORY
+    EmbAJAXMemory::end();
+#endif
+}
+
+#if EMBAJAX_VIEWPORT_UPDATES
+/** Parse two hex words of a bit mask sent by the client, separated by '.'. See EmbAJAXClientView. @returns the remainder of arg */
+static const char* parseViewMask(const char* arg, uint32_t *mask) {
+    for (uint8_t i = 0; i < 2; ++i) {
+        char *end;
+        mask[i] = strtoul(arg, &end, 16);
+        arg = (*end == '.') ? end + 1 : end;
+    }
+    return arg;
 }
+#endif
 
-void EmbAJAXBase::handleRequest(EmbAJAXBase** _children, size_t NUM, void (*change_callback)()) {
+void EmbAJAXBase::handleRequest(void (*change_callback)(), EmbAJAXPageBase *page) {
+    EMBAJAX_TRACE_SPAN("handleRequest", 0);
     char conversion_buf[EMBAJAX_MAX_ID_LEN];
+#if EMBAJAX_METRICS
+    const uint32_t start = micros();
+#endif
+#if EMBAJAX_MEMORY
+    EmbAJAXMemory::begin(EmbAJAXMemory::HandleRequest);
+#endif
+    page->_latest_ping = millis();
+    EmbAJAXClientSession *session = page->findSession(atol(_driver->getArg("cid", conversion_buf, EMBAJAX_MAX_ID_LEN)));
+#if EMBAJAX_METRICS
+    // the client tells us how long its previous request took (round trip, and time waiting in its queue)
+    const char *latency = _driver->getArg("latency", conversion_buf, EMBAJAX_MAX_ID_LEN);
+    if (latency[0] != '\0') {
+        const char *wait = strchr(latency, '.');
+        page->_client_latency.record((uint16_t) min(atol(latency), 0xFFFFL), wait ? (uint16_t) min(atol(wait + 1), 0xFFFFL) : 0);
+    }
+#endif
+
+    // admission control: plain polls (without an id) may be turned away, if too frequent, but value changes are always handled
+    if (_driver->getArg("id", conversion_buf, EMBAJAX_MAX_ID_LEN)[0] == '\0') {
+        uint16_t retry = page->admitPoll(session);
+        if (retry) {
+            EMBAJAX_COUNT(polls_rejected);
+            _driver->printHeader(false);
+            _driver->printFormatted("{\"retry\":", INTEGER_VALUE(retry), "}" EMBAJAX_NL);
+            _driver->finishContent();
+#if EMBAJAX_MEMORY
+            EmbAJAXMemory::end();
+#endif
+            return;
+        }
+    }
 
     // handle value changes sent from client
     uint16_t client_revision = atoi(_driver->getArg("revision", conversion_buf, EMBAJAX_MAX_ID_LEN));
@@ -628,8 +1729,46 @@ void EmbAJAXBase::handleRequest(EmbAJAXBase** _children, size_t NUM, void (*chan
         // synced to the client.
         client_revision = 0;
     }
+    if (client_revision == 0) EMBAJAX_COUNT(resyncs);
+    // Update classes: For each (but Realtime), the client tells us the revision it has last synced that class at, and how many ms ago
+    EmbAJAXUpdateClasses classes = { 1 << EmbAJAXElement::Realtime, { 0, 0 } };
+    char classes_buf[24];
+    const char *classes_arg = _driver->getArg("classes", classes_buf, sizeof(classes_buf));
+    if (classes_arg[0] != '\0') {
+        for (uint8_t i = 0; i < EmbAJAXElement::Realtime; ++i) {
+            classes.since[i] = atol(classes_arg);
+            if (classes.since[i] > _driver->revision()) classes.since[i] = 0;  // see above
+            const char *age = strchr(classes_arg, '.');
+            if (age && (uint32_t) atol(age + 1) >= page->_update_interval[i]) classes.due |= 1 << i;
+            classes_arg = strchr(classes_arg, ',');
+            if (!classes_arg) break;
+            ++classes_arg;
+        }
+        _update_classes = &classes;
+    }
+#if EMBAJAX_VIEWPORT_UPDATES
+    // Viewport: For plain polls, the client may tell us which elements are in, and out of view, and which have just scrolled into view
+    EmbAJAXClientView view;
+    char view_buf[40];
+    const char *view_arg = _driver->getArg("view", view_buf, sizeof(view_buf));
+    if (view_arg[0] != '\0') {
+        view_arg = parseViewMask(view_arg, view.in_view);
+        parseViewMask(view_arg, view.out_of_view);
+        parseViewMask(_driver->getArg("enter", view_buf, sizeof(view_buf)), view.entered);
+        _client_view = &view;
+    }
+#endif
+
     const char *id = _driver->getArg("id", conversion_buf, EMBAJAX_MAX_ID_LEN);
-    EmbAJAXElement *element = (id[0] == '\0') ? 0 : findChild(id);
+    EmbAJAXElement *element = 0;
+    if (id[0] != '\0') {
+        EMBAJAX_TRACE_SPAN("findChild", 0);
+        element = findChild(id);
+    }
+#if EMBAJAX_METRICS
+    if (id[0] == '\0') ++_metrics.polls;
+    else ++_metrics.inputs;
+#endif
     if (element) {
 #if EMBAJAX_DEBUG > 2
         Serial.print("Updating ");
@@ -639,10 +1778,18 @@ void EmbAJAXBase::handleRequest(EmbAJAXBase** _children, size_t NUM, void (*chan
         Serial.print(" old value ");
         Serial.println(element->value());
 #endif
-        element->updateFromDriverArg("value");
         element->setChanged();                  // See bottom of function for an explanation on revision handling here, and in general
         element->revision = client_revision;
-        if (change_callback) change_callback();
+        if (_update_classes && element->updateClass() != EmbAJAXElement::Realtime) element->revision = classes.since[element->updateClass()];
+        {
+            // NOTE: Only after adjusting the revision, so that any changes made to the element from within its own callback(s) will be synced back to the client
+            EMBAJAX_TRACE_SPAN("updateFromDriverArg", element);
+            element->updateFromDriverArg("value");
+        }
+        if (change_callback) {
+            EMBAJAX_TRACE_SPAN("change_callback", element);
+            change_callback();
+        }
 #if EMBAJAX_DEBUG > 2
         Serial.print("(temp) new revision ");
         Serial.print(element->revision);
@@ -650,7 +1797,9 @@ void EmbAJAXBase::handleRequest(EmbAJAXBase** _children, size_t NUM, void (*chan
         Serial.println(element->value());
 #endif
     }
-    _driver->nextRevision();
+    EmbAJAXElement::_other_change = false;
+    EmbAJAXElement::_held_back = EmbAJAXTransaction::open();
+    if (!EmbAJAXElement::_held_back) _driver->nextRevision();  // otherwise, changes are published after the transaction has been committed
 #if EMBAJAX_DEBUG > 2
     if (element || (EMBAJAX_DEBUG > 3)) {
         Serial.print("Update done. Client revision ");
@@ -661,10 +1810,95 @@ void EmbAJAXBase::handleRequest(EmbAJAXBase** _children, size_t NUM, void (*chan
 #endif
 
     // then relay value changes that have occured in the server (possibly in response to those sent)
+    const uint16_t server_revision = _driver->revision();
+    const uint16_t max_size = page->_max_response_size;
+    // High priority elements first, then the others in page order, as long as they fit. If the previous response was incomplete,
+    // the client tells us the revision it was sent at, where it stopped, and which update classes were due.
+    EmbAJAXUpdatePass pass = { true, 0, 0, 0, max_size, 0xFFFF, false, false };
+    if (max_size) {
+        const char *resume = _driver->getArg("resume", conversion_buf, EMBAJAX_MAX_ID_LEN);
+        if (resume[0] != '\0' && strchr(resume, ',')) {
+            pass.resume_revision = atoi(resume);
+            resume = strchr(resume, ',') + 1;
+            pass.resume_index = atoi(resume);
+            if (pass.resume_revision > server_revision) pass.resume_index = 0;
+            // Classes that have become due, since, wait for the next round, as they were not synced up to resume_index
+            else if (strchr(resume, ',')) classes.due &= atoi(strchr(resume, ',') + 1) | 1 << EmbAJAXElement::Realtime;
+        }
+    }
+#if EMBAJAX_MAX_SESSIONS > 0 || EMBAJAX_METRICS
+    const uint32_t bytes_before = _driver->contentBytes();
+#endif
     _driver->printHeader(false);
-    _driver->printFormatted("{\"revision\": ", INTEGER_VALUE(_driver->revision()), ",\n\"updates\": [\n");
-    sendUpdates(_children, NUM, client_revision, true);
-    _driver->printContent("\n]}\n");
+
+    const char* cached = 0;
+#if EMBAJAX_RESPONSE_CACHE > 0
+    // Polls from clients at the same revision produce the same response, as long as the server revision has not advanced.
+    // Value changes sent from the client are excluded, as these are special-cased, above.
+    const uint16_t key[EmbAJAXResponseCache::KeyLength] = { client_revision, server_revision, _update_classes ? (uint16_t) classes.due : (uint16_t) 0xFFFF,
+                                                             classes.since[0], classes.since[1], pass.resume_revision, pass.resume_index, max_size };
+    bool cacheable = !element;
+#if EMBAJAX_VIEWPORT_UPDATES
+    if (_client_view) cacheable = false;  // response depends on the client's view
+#endif
+    if (EmbAJAXThrottle::pending()) cacheable = false;  // held back changes become due with time, without a change in revision
+    if (cacheable) {
+        cached = response_cache.find(page, key);
+        if (!cached) response_cache.record(page, key);
+    }
+#endif
+
+    if (cached) {
+        EMBAJAX_COUNT(cache_hits);
+        _driver->printContent(cached);
+    } else {
+        _driver->printContent("{\"updates\":[" EMBAJAX_NL);
+        if (max_size) {
+            _update_pass = &pass;
+            bool sent = sendUpdates(client_revision, true);
+            pass.high_priority = false;
+            sendUpdates(client_revision, !sent);
+            _update_pass = 0;
+        } else {
+            sendUpdates(client_revision, true);
+        }
+        // Elements may have been changed while sending updates (see EmbAJAXElement::refreshValue()). Such changes have been sent along with this
+        // response, so advance the revision, to avoid sending them to this client, again. (Unless held back by a transaction.) However, if anything
+        // else was changed in the meantime (from loop(), with an asynchronous server), that change has the same revision, but may not have been
+        // sent. Don't advance, then. This client will receive the refreshed values one more time, instead.
+        if (!EmbAJAXElement::_held_back && !EmbAJAXElement::_other_change) _driver->nextRevision();
+        if (pass.stopped_at != 0xFFFF) {
+            // Incomplete: All elements before stopped_at are now in sync with the current revision, the others are not.
+            _driver->printFormatted(EMBAJAX_NL "]," EMBAJAX_NL "\"revision\":", INTEGER_VALUE(client_revision), "," EMBAJAX_NL "\"resume\":\"",
+                                    INTEGER_VALUE(_driver->revision()), ",", INTEGER_VALUE(pass.stopped_at), ",", INTEGER_VALUE(classes.due), "\"");
+        } else {
+            _driver->printFormatted(EMBAJAX_NL "]," EMBAJAX_NL "\"revision\":", INTEGER_VALUE(_driver->revision()));
+            if (_update_classes) _driver->printFormatted("," EMBAJAX_NL "\"synced\":", INTEGER_VALUE(classes.due));
+        }
+    }
+    _update_classes = 0;
+#if EMBAJAX_VIEWPORT_UPDATES
+    _client_view = 0;
+#endif
+#if EMBAJAX_RESPONSE_CACHE > 0
+    response_cache.stopRecording();
+#endif
+    if (page->_poll_interval) {
+        _driver->printFormatted("," EMBAJAX_NL "\"next_poll_ms\":", INTEGER_VALUE(page->_poll_interval));
+    }
+    _driver->printContent("}" EMBAJAX_NL);
+    _driver->finishContent();
+#if EMBAJAX_MAX_SESSIONS > 0 || EMBAJAX_METRICS
+    const uint32_t bytes_sent = _driver->contentBytes() - bytes_before;
+    if (session) page->updateSession(session, client_revision, bytes_sent);
+#endif
+#if EMBAJAX_METRICS
+    _metrics.bytes_update += bytes_sent;
+    EmbAJAXMetrics::addTime(_metrics.request_time, &_metrics.request_time_sum, micros() - start);
+#endif
+#if EMBAJAX_MEMORY
+    EmbAJAXMemory::end();
+#endif
 
     /* Explanation on revision handling:
      * Bascis - Revision signifies what changes a particular client has already seen. Each client keeps a separate revision number. Each element hold the reivison number of
@@ -679,5 +1913,6 @@ void EmbAJAXBase::handleRequest(EmbAJAXBase** _children, size_t NUM, void (*chan
      *          To avoid syncing back this change, while still making sure any secondary change is synced: We first call setChanged() (so that the driver is aware that a new
      *          revision may be needed). Then, we re-set the revision to the revision number of the client. Usually it will stay that way, unless secondary changes trigger another
      *          update. Finally, after syncing back changes, we increase the revision, again, such that all further clients will be updated, appropriately. */
-    if (element) element->revision = _driver->revision();
+    if (element) element->revision = EmbAJAXElement::_held_back ? _driver->setChanged() : _driver->revision();  // in a transaction: publish with it
+    EmbAJAXElement::_held_back = false;
 }
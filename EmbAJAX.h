@@ -26,11 +26,137 @@
 /** Maximum length to assume for id strings. Reducing this could help to reduce RAM usage, a little. */
 #define EMBAJAX_MAX_ID_LEN 16
 
+/** Maximum number of arguments kept from a single request. See EmbAJAXOutputDriverBase::parseRequestBody(). The client sends up to nine
+ *  (id, value, revision, resume, classes, cid, view, enter, latency), the remainder is headroom for custom elements. Each takes 2 pointers of RAM. */
+#if !defined EMBAJAX_MAX_ARGS
+#define EMBAJAX_MAX_ARGS 12
+#endif
+
+/** Maximum length of a request body (i.e. mostly of the values sent from text inputs), for drivers that need to buffer the request,
+ *  themselves (EmbAJAXOutputDriverESPAsync, EmbAJAXOutputDriverRawSocket). Longer requests are truncated. The value is sent last, so only
+ *  the value is cut short. Note that values are URL encoded, i.e. each non-ASCII character takes up to 12 bytes. Increase this, if you use
+ *  long text inputs (see EmbAJAXTextInput). */
+#if !defined EMBAJAX_MAX_REQUEST_LEN
+#define EMBAJAX_MAX_REQUEST_LEN 256
+#endif
+
+/** Length to assume for texts that are not stored inside an element (the content of an EmbAJAXMutableSpan, or the label of a
+ *  button), when computing the maximum size of update responses at compile time. See EmbAJAXElement::maxUpdateSize() */
+#if !defined EMBAJAX_ASSUMED_TEXT_LEN
+#define EMBAJAX_ASSUMED_TEXT_LEN 64
+#endif
+
+/** Number of clients to keep track of, per page. See EmbAJAXPageBase::clientSession(). Each uses 20 bytes of RAM. Set to 0 to disable
+ *  tracking of clients (and the per-client limit in EmbAJAXPageBase::setAdmissionLimits()). */
+#if !defined EMBAJAX_MAX_SESSIONS
+#define EMBAJAX_MAX_SESSIONS 4
+#endif
+
 /** \def EMBAJAX_DEBUG
  * Set to a value above 0 for diagnostics on Serial and browser console (for troubleshooting, only, as it increase flash, RAM, and processing requirements,
  * considerably. */
 // #define EMBAJAX_DEBUG 3
 
+/** \def EMBAJAX_MINIFY
+ * Control whitespace in the generated HTML, JavaScript, and JSON code
+ *
+ * By default, the code sent to the client is stripped of line breaks and indentation, at compile time. This saves flash, bytes on the wire,
+ * and parsing time in the client. Set this to 0 to keep the readable form, e.g. for inspecting the code in the browser. Defaults to 0, if
+ * EMBAJAX_DEBUG is set, 1 otherwise. */
+//#define EMBAJAX_MINIFY 0
+
+#if !defined EMBAJAX_MINIFY
+ #if EMBAJAX_DEBUG > 0
+  #define EMBAJAX_MINIFY 0
+ #else
+  #define EMBAJAX_MINIFY 1
+ #endif
+#endif
+
+/** \def EMBAJAX_COMPRESSION_WINDOW
+ * Compression of large AJAX responses
+ *
+ * When a client (re-)connects, it is sent the state of all elements, which can easily amount to several kilobytes of highly repetitive JSON
+ * code. Set this to a power of two between 256 and 16384 (e.g. 512) to compress AJAX responses larger than EMBAJAX_COMPRESSION_THRESHOLD
+ * using a simple LZ scheme, decoded by the page script. The output driver will use EMBAJAX_COMPRESSION_WINDOW * 5 / 4 + 64 bytes of additional
+ * RAM. Set to 0 (the default) to disable compression. See EmbAJAXCompressedOutput. */
+//#define EMBAJAX_COMPRESSION_WINDOW 512
+
+#if !defined EMBAJAX_COMPRESSION_WINDOW
+#define EMBAJAX_COMPRESSION_WINDOW 0
+#endif
+
+/** \def EMBAJAX_COMPRESSION_THRESHOLD
+ * AJAX responses up to this size (in bytes) are sent uncompressed. Must not be larger than EMBAJAX_COMPRESSION_WINDOW. */
+#if !defined EMBAJAX_COMPRESSION_THRESHOLD
+#define EMBAJAX_COMPRESSION_THRESHOLD (EMBAJAX_COMPRESSION_WINDOW / 2)
+#endif
+
+/** \def EMBAJAX_RESPONSE_CACHE
+ * Shared cache of update responses
+ *
+ * When several clients watch the same page, they will usually poll at the same revision, and receive identical responses. Set this to a number
+ * of bytes (e.g. 1024) to keep the EMBAJAX_RESPONSE_CACHE_ENTRIES most recent responses in RAM, and serve them to further clients, as long as the
+ * server revision has not changed, instead of rendering them again. Responses too large for their share of the cache are not cached. Set to 0
+ * (the default) to disable the cache. */
+//#define EMBAJAX_RESPONSE_CACHE 1024
+
+#if !defined EMBAJAX_RESPONSE_CACHE
+#define EMBAJAX_RESPONSE_CACHE 0
+#endif
+
+/** Number of responses to keep in the cache. See EMBAJAX_RESPONSE_CACHE. */
+#if !defined EMBAJAX_RESPONSE_CACHE_ENTRIES
+#define EMBAJAX_RESPONSE_CACHE_ENTRIES 2
+#endif
+
+/** \def EMBAJAX_METRICS
+ * Runtime counters for monitoring, such as the number of polls served, and histograms of processing times. See EmbAJAXMetrics, and
+ * EmbAJAXMetricsPage. Set to 1 to enable them. The counters take 108 bytes of RAM, plus 76 bytes per page for the latencies reported by
+ * clients (EmbAJAXPageBase::clientLatency()), and 8 bytes for timing the page being rendered. Disabled by default. */
+//#define EMBAJAX_METRICS 1
+
+#if !defined EMBAJAX_METRICS
+#define EMBAJAX_METRICS 0
+#endif
+
+/** \def EMBAJAX_TRACE
+ * Trace spans for profiling
+ *
+ * Set this to a number of entries (e.g. 64) to record the time spent rendering pages, handling requests, in single elements, and in
+ * user callbacks into a ring buffer of that size (12 to 16 bytes per entry). The recorded spans can be dumped in Chrome trace event format,
+ * see EmbAJAXTrace. Set to 0 (the default) to compile all trace hooks to nothing. */
+//#define EMBAJAX_TRACE 64
+
+#if !defined EMBAJAX_TRACE
+#define EMBAJAX_TRACE 0
+#endif
+
+/** \def EMBAJAX_MEMORY
+ * Memory accounting
+ *
+ * Set this to 1 to record free heap (and its low water mark), and the stack depth used while serving pages, and handling requests,
+ * sampled at the start, and at each chunk of output passed to the server. See EmbAJAXMemory. This takes about 30 bytes of RAM, and
+ * some time per chunk of output (depending on the platform). Set to 0 (the default) to compile the sampling to nothing. */
+//#define EMBAJAX_MEMORY 1
+
+#if !defined EMBAJAX_MEMORY
+#define EMBAJAX_MEMORY 0
+#endif
+
+/** \def EMBAJAX_VIEWPORT_UPDATES
+ * Viewport-aware updates
+ *
+ * Set this to 1 to have clients report which elements are scrolled out of view (using IntersectionObserver, where available), with each poll.
+ * Changes to elements out of view are then not sent to that client. When an element scrolls into view, its full state is sent, right away. This
+ * saves bandwidth, and rendering time on long pages, particularly on phones. The report is sent as a compact bit mask of hashed ids, which may
+ * occasionally cause an element out of view to be sent, anyway, but never the other way around. Set to 0 (the default) to disable. */
+//#define EMBAJAX_VIEWPORT_UPDATES 1
+
+#if !defined EMBAJAX_VIEWPORT_UPDATES
+#define EMBAJAX_VIEWPORT_UPDATES 0
+#endif
+
 /**V@file EmbAJAX.h
  *
  * Main include file.
@@ -67,6 +193,212 @@ class EmbAJAXElement;
 class EmbAJAXContainerBase;
 class EmbAJAXPageBase;
 
+/** Internal helper for limiting the size of update responses: State of one EmbAJAXBase::sendUpdates() pass.
+ *  See EmbAJAXPageBase::setMaxResponseSize() */
+struct EmbAJAXUpdatePass {
+    bool high_priority;         ///< include high priority elements (true), or regular elements (false), only
+    uint16_t resume_revision;   ///< for regular elements before resume_index, the client already knows all changes up to this revision
+    uint16_t resume_index;
+    uint16_t index;             ///< running index of regular elements
+    uint16_t budget;            ///< remaining bytes
+    uint16_t stopped_at;        ///< index of the first regular element that did not fit, or 0xFFFF
+    bool sent;                  ///< whether any regular element has been sent
+    bool hidden;                ///< inside a hidden EmbAJAXHideableContainer: elements are counted, but not sent
+};
+
+#if EMBAJAX_VIEWPORT_UPDATES
+/** Internal helper for viewport-aware updates: Elements the client reports in view, out of view, and as just scrolled into view, as
+ *  bit masks over hashed ids. See EMBAJAX_VIEWPORT_UPDATES */
+struct EmbAJAXClientView {
+    uint32_t in_view[2];
+    uint32_t out_of_view[2];
+    uint32_t entered[2];        ///< these are sent in full
+    /** @returns the bit representing the given id in the masks. Must match the client side viewBit() */
+    static uint8_t bit(const char* id) {
+        uint16_t hash = 0;
+        while (*id) hash = hash * 31 + (uint8_t) *(id++);
+        return hash & 63;
+    }
+    static bool test(const uint32_t *mask, uint8_t bit) {
+        return mask[bit >> 5] & ((uint32_t) 1 << (bit & 31));
+    }
+    /** @returns true, if updates to the element should be held back. Elements sharing their bit with any element in view, are not. */
+    bool outOfView(uint8_t bit) const {
+        return test(out_of_view, bit) && !test(in_view, bit);
+    }
+};
+#endif
+
+/** Internal helper for multi-rate updates: Update classes due in the current request. See EmbAJAXElement::setUpdateClass() */
+struct EmbAJAXUpdateClasses {
+    uint8_t due;                ///< bit mask of the update classes to send
+    uint16_t since[2];          ///< per update class (but Realtime), the revision the client has last synced that class at
+};
+
+#if EMBAJAX_METRICS
+/** @brief Runtime counters of the EmbAJAX framework
+ *
+ *  See EmbAJAXBase::metrics(), and EmbAJAXMetricsPage for exporting these. All counters are cumulative since startup. Times are
+ *  measured in microseconds, and counted in histogram buckets. See bucketLimit(). */
+struct EmbAJAXMetrics {
+    enum {
+        Buckets = 8
+    };
+    uint32_t page_renders;          ///< number of pages served
+    uint32_t polls;                 ///< number of update requests served, that did not carry a value change
+    uint32_t polls_rejected;        ///< number of polls turned away by admission control (see EmbAJAXPageBase::setAdmissionLimits())
+    uint32_t inputs;                ///< number of update requests carrying a value change
+    uint32_t resyncs;               ///< number of update requests, for which all elements had to be sent (new clients, or lost sync)
+    uint32_t cache_hits;            ///< number of responses served from the cache (see EMBAJAX_RESPONSE_CACHE)
+    uint32_t bytes_page;            ///< bytes sent in pages (not counting HTTP headers)
+    uint32_t bytes_update;          ///< bytes sent in update responses (not counting HTTP headers)
+    uint32_t buffer_flushes;        ///< number of times the formatting buffer of the output driver has been passed on to the server
+    uint32_t render_time[Buckets];  ///< histogram of the time needed to serve pages
+    uint32_t render_time_sum;       ///< total time needed to serve pages
+    uint32_t request_time[Buckets]; ///< histogram of the time needed to serve update requests (excluding rejected polls)
+    uint32_t request_time_sum;      ///< total time needed to serve update requests
+    /** Upper limit (in microseconds) of the given histogram bucket. The last bucket has no limit. */
+    static uint32_t bucketLimit(uint8_t bucket);
+    /** Add a time to the given histogram */
+    static void addTime(uint32_t *histogram, uint32_t *sum, uint32_t us);
+};
+#endif
+
+#if EMBAJAX_TRACE > 0
+/** @brief Trace span for profiling
+ *
+ *  See EMBAJAX_TRACE. A span is recorded from construction to destruction of this object. Use the #EMBAJAX_TRACE_SPAN() macro to trace a
+ *  scope, which also works in your own code (e.g. a change callback). The recorded spans can be written to Serial, or any other Print, using
+ *  dump(), or be served using an EmbAJAXTracePage. Load the result in chrome://tracing, or https://ui.perfetto.dev .
+ *
+ *  @code
+ *  EmbAJAXTrace::dump(Serial);
+ *  @endcode */
+class EmbAJAXTrace {
+public:
+    /** @param name name of the span. Must be a static string.
+     *  @param element element the span refers to (may be 0). The id of the element is shown in the trace. */
+    EmbAJAXTrace(const char* name, EmbAJAXElement* element) : _name(name), _element(element), _start(micros()) {}
+    ~EmbAJAXTrace() {
+        record(_name, _element, _start, micros() - _start);
+    }
+    /** Write the recorded spans, oldest first, in Chrome trace event format (JSON). Nothing is recorded, while dumping. */
+    static void dump(Print &out);
+    /** Forget all recorded spans */
+    static void clear();
+private:
+    static void record(const char* name, EmbAJAXElement* element, uint32_t start, uint32_t duration);
+    struct Span {
+        const char* name;
+        EmbAJAXElement* element;
+        uint32_t start;
+        uint32_t duration;
+    };
+    static Span _spans[EMBAJAX_TRACE];
+    static uint16_t _next;
+    static uint16_t _count;
+    static bool _suspended;
+    const char* _name;
+    EmbAJAXElement* _element;
+    uint32_t _start;
+};
+/** Trace the remainder of the current scope. See EmbAJAXTrace. Compiles to nothing, unless EMBAJAX_TRACE is set.
+ *  @param name name of the span (a static string)
+ *  @param element element that the span refers to, or 0 */
+#define EMBAJAX_TRACE_SPAN(name, element) EmbAJAXTrace embajax_trace_span(name, element)
+#else
+#define EMBAJAX_TRACE_SPAN(name, element)
+#endif
+
+/** @brief Memory usage of page rendering, and request handling
+ *
+ *  See EmbAJAXMemory::usage() */
+struct EmbAJAXMemoryUsage {
+    uint32_t heap_free;     ///< free heap at the start of the latest pass
+    uint32_t heap_low;      ///< lowest free heap seen during any pass (low water mark)
+    uint16_t stack_depth;   ///< deepest stack usage seen during any pass, counted from the entry into EmbAJAX (high water mark)
+    uint16_t passes;        ///< number of passes recorded (stops counting at 65535)
+};
+
+/** @brief Memory accounting
+ *
+ *  With EMBAJAX_MEMORY set, free heap and stack depth are sampled while serving pages, and handling requests, in order to find out
+ *  how close these come to running out of memory:
+ *
+ *  @code
+ *  const EmbAJAXMemoryUsage &u = EmbAJAXMemory::usage(EmbAJAXMemory::PrintPage);
+ *  Serial.println(u.heap_low);
+ *  Serial.println(u.stack_depth);
+ *  @endcode
+ *
+ *  Free heap is queried from the platform on ESP8266, ESP32, RP2040, and AVR. On other platforms (e.g. when building for the host), provide
+ *  a function using setFreeHeapFunction(), for instance based on hooks into your allocator.
+ *
+ *  The static RAM taken by the objects of a page can be determined at compile time, using footprint(). */
+class EmbAJAXMemory {
+public:
+    enum Pass {
+        PrintPage,      ///< serving the page
+        HandleRequest,  ///< handling update requests
+        NumPasses
+    };
+    /** Static RAM occupied by the given objects, in bytes. Pass pointers to your page, its elements array (if any), and all elements,
+     *  including those nested in (untyped) containers. The children of an EmbAJAXTypedContainer, or an EmbAJAXTypedPage, are counted
+     *  along with their parent, and must not be listed again. All memory of the objects provided by EmbAJAX, including id tables of
+     *  EmbAJAXRadioGroup, option labels, and text buffers, is allocated inside the objects, themselves. The result is a compile time constant:
+     *
+     *  @code
+     *  static_assert(EmbAJAXMemory::footprint(&page, &page_elements, &check, &slider, &radio) < 1024, "page too large");
+     *  @endcode
+     *
+     *  EmbAJAXTypedPage::footprint() is the same as EmbAJAXMemory::footprint(&page). */
+    template<typename T, typename... Ts> static constexpr size_t footprint(const T* object, Ts... objects) {
+        return sizeof(*object) + childrenFootprint(object, 0) + footprint(objects...);
+    }
+    static constexpr size_t footprint() {
+        return 0;
+    }
+#if EMBAJAX_MEMORY
+    /** Provide a function to query free heap, overriding the platform default. Pass 0 to return to the default. */
+    static void setFreeHeapFunction(uint32_t (*free_heap)()) {
+        _free_heap = free_heap;
+    }
+    /** Free heap in bytes (0, if unknown on this platform) */
+    static uint32_t freeHeap();
+    /** Memory usage recorded for the given pass */
+    static const EmbAJAXMemoryUsage& usage(Pass pass) {
+        return _usage[pass];
+    }
+    /** Forget all recorded usage */
+    static void reset();
+    /** Internal: Start recording a pass */
+    static void begin(Pass pass);
+    /** Internal: Take a sample, if recording */
+    static void sample();
+    /** Internal: Finish recording a pass */
+    static void end();
+private:
+    static EmbAJAXMemoryUsage _usage[NumPasses];
+    static uint8_t _pass;
+    static uintptr_t _stack_base;
+    static uint32_t (*_free_heap)();
+#endif
+private:
+    /** Children owned by the object (see EmbAJAXBase::childrenFootprint()). Untyped containers do not know the types of their children,
+     *  which are listed separately, instead. */
+    template<typename T> static constexpr auto childrenFootprint(const T*, int) -> decltype(T::childrenFootprint()) {
+        return T::childrenFootprint();
+    }
+    static constexpr size_t childrenFootprint(const void*, long) {
+        return 0;
+    }
+};
+#if EMBAJAX_MEMORY
+#define EMBAJAX_MEMORY_SAMPLE() EmbAJAXMemory::sample()
+#else
+#define EMBAJAX_MEMORY_SAMPLE()
+#endif
+
 /** @brief Abstract base class for anything shown on an EmbAJAXPage
  *
  *  Anything that can be displayed on an EmbAJAXPage will have to inherit from this class
@@ -106,12 +438,28 @@ public:
     void setEnabled(bool enabled) {
         setBasicProperty(Enabledness, enabled);
     }
+    /** Upper bound on the number of bytes sendUpdates() writes for this class of object, i.e. the size of its contribution to a full resync.
+     *  This is a compile time constant, provided for each class, but derived classes, that send additional properties, need to provide their
+     *  own. Objects that never send updates, such as EmbAJAXStatic, return 0. See EmbAJAXTypedPage::maxResponseSize().
+     *
+     *  @note Ids are not known at compile time, and are assumed to be shorter than EMBAJAX_MAX_ID_LEN (which is also the longest id that can
+     *        be received from the client). Longer ids make the bound too low. */
+    static constexpr size_t maxUpdateSize() {
+        return 0;
+    }
+    /** Static RAM occupied by other objects owned by this class of object (i.e. the children of a container, but not the container
+     *  itself). Compile time constant. See EmbAJAXTypedPage::footprint(). */
+    static constexpr size_t childrenFootprint() {
+        return 0;
+    }
     enum Property {
         Visibility=0,
         Enabledness=1,
         Value=2,
         FirstElementSpecificProperty=3,
-        HTMLAllowed=7
+        HTMLAllowed=7,
+        UpdateClassBits=8,      // two bits: 8 and 9. Not a property, but kept in the same flags
+        HighPriority=10
     };
     /** Find child element of this one, with the given id. Returns 0, if this is not a container, or
      *  does not have such a child. @see EmbAJAXContainer, and @see EmbAJAXHideableContainer. */
@@ -119,26 +467,62 @@ public:
         UNUSED(id);
         return 0;
     }
+#if EMBAJAX_METRICS
+    /** Runtime counters. See EmbAJAXMetrics */
+    static const EmbAJAXMetrics& metrics() {
+        return _metrics;
+    }
+#endif
 protected:
-template<size_t NUM> friend class EmbAJAXContainer;
+friend class EmbAJAXContainerBase;
+friend class EmbAJAXOutputDriverBase;
+friend class EmbAJAXMetricsPage;
+friend class EmbAJAXTracePage;
+template<typename... Ts> friend class EmbAJAXTypedList;
+friend class EmbAJAXPageBase;
     virtual void setBasicProperty(uint8_t num, bool status) { UNUSED(num); UNUSED(status); };
 
     static EmbAJAXOutputDriverBase *_driver;
+    /** Restrictions on the current sendUpdates() pass, or 0 for none */
+    static EmbAJAXUpdatePass *_update_pass;
+    /** Update classes due in the current sendUpdates() pass, or 0 for all */
+    static EmbAJAXUpdateClasses *_update_classes;
+#if EMBAJAX_VIEWPORT_UPDATES
+    /** Elements in view of the client in the current sendUpdates() pass, or 0 for all */
+    static EmbAJAXClientView *_client_view;
+#endif
+#if EMBAJAX_METRICS
+    static EmbAJAXMetrics _metrics;
+#endif
     static char itoa_buf[8];
     constexpr static const char null_string[1] = "";
 
-    /** Filthy trick to keep (template) implementation out of the header. See EmbAJAXContainer::printChildren() */
+    /** Print the given children, one after the other. See EmbAJAXContainerBase::print() */
     void printChildren(EmbAJAXBase** children, size_t num) const;
-    /** Filthy trick to keep (template) implementation out of the header. See EmbAJAXContainer::sendUpdates() */
-    bool sendUpdates(EmbAJAXBase** children, size_t num, uint16_t since, bool first);
-    /** Filthy trick to keep (template) implementation out of the header. See EmbAJAXContainer::findChild() */
-    EmbAJAXElement* findChild(EmbAJAXBase** children, size_t num, const char*id) const;
     /** Filthy trick to keep (template) implementation out of the header. See EmbAJAXPage::print() */
     void printPage(EmbAJAXBase** children, size_t num, const char* _title, const char* _header, uint16_t _min_interval) const;
-    /** Filthy trick to keep (template) implementation out of the header. See EmbAJAXPage::handleRequest() */
-    void handleRequest(EmbAJAXBase** children, size_t num, void (*change_callback)());
+    /** Prints everything in a page up to the first child element. See printPage() */
+    void printPageHeader(const char* _title, const char* _header, uint16_t _min_interval) const;
+    /** Prints everything in a page after the last child element. See printPage() */
+    void printPageFooter() const;
+    /** Filthy trick to keep (template) implementation out of the header. See EmbAJAXPage::handleRequest().
+     *  Children are looked up, and updates are sent using the (virtual) findChild(), and sendUpdates() of this object.
+     *  @param page the page settings to apply (this object) */
+    void handleRequest(void (*change_callback)(), EmbAJAXPageBase *page);
 };
 
+#if !USE_PROGMEM_STRINGS
+/** Internal helper type for printFormatted(). Use the #JS_QUOTED_STRING(), #HTML_QUOTED_STRING(), #HTML_ESCAPED_STRING(), and
+ *  #PLAIN_STRING() macros, instead. */
+template<char KIND> struct EmbAJAXFormatStringArg {
+    const char* value;
+};
+/** Internal helper type for printFormatted(). Use the #INTEGER_VALUE() macro, instead. */
+struct EmbAJAXFormatIntegerArg {
+    int value;
+};
+#endif
+
 /** @brief Abstract base class for output drivers/server implementations
  *
  *  Output driver as an abstraction over the server read/write commands.
@@ -147,17 +531,30 @@ template<size_t NUM> friend class EmbAJAXContainer;
  *
  *  Providing your own driver is very easy. All you have to do it to wrap the
  *  basic functions for writing to the server and retrieving (POST) arguments:
- *  printHeader(), printContent(), and getArg().
+ *  printHeader(), writeContent(), and getArg().
  */
 class EmbAJAXOutputDriverBase {
 public:
     EmbAJAXOutputDriverBase() {
         _revision = 1;
         next_revision = _revision;
+        _numargs = 0;
     }
 
     virtual void printHeader(bool html) = 0;
-    virtual void printContent(const char *content) = 0;
+    /** Print the header for a response of another type than a page, or an AJAX response (e.g. EmbAJAXMetricsPage). The default implementation
+     *  falls back to printHeader(false), i.e. "text/json".
+     *  @param content_type MIME type of the response */
+    virtual void printTypedHeader(const char* content_type) {
+        UNUSED(content_type);
+        printHeader(false);
+    }
+    /** Send a piece of content. All content passes through here (to be counted, or recorded into the response cache, as configured),
+     *  before it is handed to writeContent(). */
+    void printContent(const char *content);
+    /** Called after the last printContent() of each response (page, or AJAX reply). Drivers that buffer, or transform their
+     *  output may override this. The default implementation does nothing. */
+    virtual void finishContent() {}
     virtual const char* getArg(const char* name, char* buf, int buflen) = 0;
     /** Set up the given page to be served on the given path.
      *
@@ -177,6 +574,12 @@ public:
     void nextRevision() {
         _revision = next_revision;
     }
+#if EMBAJAX_MAX_SESSIONS > 0 || EMBAJAX_METRICS
+    /** Number of bytes of content sent since startup. Used for the byte counts in EmbAJAXClientSession, and EmbAJAXMetrics. */
+    uint32_t contentBytes() const {
+        return _content_bytes;
+    }
+#endif
     /** Quotation modes. Used in printFiltered() */
     enum QuoteMode {
         NotQuoted,  ///< Will not be quoted
@@ -196,6 +599,8 @@ public:
         _printFiltered(value, quoted, HTMLescaped);
         commitBuffer();
     }
+    /** Number of bytes that printFiltered() would write for the given parameters */
+    static size_t filteredLength(const char* value, QuoteMode quoted, bool HTMLescaped);
     /** Shorthand for printFiltered(value, JSQuoted, false); */
     inline void printJSQuoted (const char* value) { printFiltered (value, JSQuoted, false); }
     /** Shorthand for printFiltered(value, HTMLQuoted, false); */
@@ -225,19 +630,136 @@ public:
     void _printContentF(const char* fmt, ...);
 #if USE_PROGMEM_STRINGS
     void _printContentF(const __FlashStringHelper*, ...);
+#else
+    /** Variadic implementation of #printFormatted(...). See there for details. */
+    template<size_t N, typename... Args> void printFormatted(const char (&segment)[N], Args&&... args) {
+        // NOTE: For a string literal, the length is N-1. Check anyway, in case a larger char array was passed.
+        _printContent(segment, (N > 1 && segment[N-2] == '\0') ? strlen(segment) : N-1);
+        printFormatted(args...);
+    }
+    /** Non-const char arrays are not static strings. Wrap them in one of the formatting macros. */
+    template<size_t N, typename... Args> void printFormatted(char (&segment)[N], Args&&... args) = delete;
+    template<char KIND, typename... Args> void printFormatted(EmbAJAXFormatStringArg<KIND> arg, Args&&... args) {
+        if (KIND == JS_QUOTED_STRING_ARG[0]) _printFiltered(arg.value, JSQuoted, false);
+        else if (KIND == HTML_QUOTED_STRING_ARG[0]) _printFiltered(arg.value, HTMLQuoted, false);
+        else if (KIND == HTML_ESCAPED_STRING_ARG[0]) _printFiltered(arg.value, NotQuoted, true);
+        else _printContent(arg.value);
+        printFormatted(args...);
+    }
+    template<typename... Args> void printFormatted(EmbAJAXFormatIntegerArg arg, Args&&... args) {
+        _printInt(arg.value);
+        printFormatted(args...);
+    }
+    void printFormatted() {
+        commitBuffer();
+    }
 #endif
+protected:
+    /** Split a request body in application/x-www-form-urlencoded format into its arguments, and decode them, in place. This is
+     *  done once per request, and does not allocate any memory. The body must stay valid, until the request has been handled.
+     *  At most EMBAJAX_MAX_ARGS arguments are kept.
+     *
+     *  @note The client sends its requests with a custom content type, so that the server libraries will pass on the body, as is,
+     *        instead of parsing it into (heap allocated) arguments.
+     *
+     *  @param body request body. May be 0, to forget about any previous request. */
+    void parseRequestBody(char* body);
+    /** Helper for implementing getArg(), using the arguments found in parseRequestBody().
+     *  @returns buf, or 0, if no request body has been parsed (in which case the driver should fall back to asking the server). */
+    const char* getParsedArg(const char* name, char* buf, int buflen) const;
+    /** Pass a piece of content on to the server. To be implemented by the driver. */
+    virtual void writeContent(const char *content) = 0;
 private:
     void _printFiltered(const char* value, QuoteMode quoted, bool HTMLescaped);
     void _printContent(const char* content);
+    /** @param content must be '\0'-terminated at content[len] */
+    void _printContent(const char* content, size_t len);
+    void _printInt(int value);
     void _printChar(const char content);
     void commitBuffer();
+    void outputContent(const char* content, size_t len);
     const int _bufsize = 64;
     char _buf[64];
     int _bufpos = 0;
     uint16_t _revision;
     uint16_t next_revision;
+    const char* _argnames[EMBAJAX_MAX_ARGS];
+    const char* _argvalues[EMBAJAX_MAX_ARGS];
+    uint8_t _numargs;
+#if EMBAJAX_MAX_SESSIONS > 0 || EMBAJAX_METRICS
+    uint32_t _content_bytes = 0;
+#endif
+};
+
+#if EMBAJAX_COMPRESSION_WINDOW > 0
+/** @brief Internal helper for EmbAJAXCompressedOutput
+ *
+ *  Streaming LZ compressor with a fixed size history window. The output is either the unmodified input (if that turns out to be
+ *  no longer than EMBAJAX_COMPRESSION_THRESHOLD), or a compressed stream, starting with a 0x01 marker byte. In the compressed stream,
+ *  a 0x01 byte introduces a back reference (followed by three bytes with the high bit set: length - 5, and the two 7-bit halves of the
+ *  distance), or an escaped literal 0x01 (followed by 0x01). The output never contains 0-bytes, and can therefore be passed to
+ *  EmbAJAXOutputDriverBase::writeContent(). */
+class EmbAJAXCompressor {
+protected:
+    EmbAJAXCompressor() : _mode(Off) {}
+    /** Start a new response. @param enable whether to attempt compression, at all */
+    void beginCompression(bool enable);
+    /** Feed content to the compressor. @returns false, if compression is not enabled for the current response. */
+    bool compressContent(const char* content);
+    /** Finish the current response, sending out any pending output */
+    void finishCompression();
+    /** Output (a piece of) the possibly compressed content. To be implemented by the driver. */
+    virtual void printCompressed(const char* content) = 0;
+private:
+    void step();
+    void put(uint8_t c);
+    void flush();
+    uint8_t at(uint16_t pos) const {
+        return _window[pos & (EMBAJAX_COMPRESSION_WINDOW - 1)];
+    }
+    uint16_t hashAt(uint16_t pos) const;
+
+    enum { Off, Collecting, Compressing } _mode;
+    uint16_t _pos;  // next position to encode
+    uint16_t _end;  // next position to read into the window
+    uint8_t _window[EMBAJAX_COMPRESSION_WINDOW];
+    uint16_t _hash[EMBAJAX_COMPRESSION_WINDOW / 8];
+    char _out[64];
+    uint8_t _outlen;
 };
 
+/** @brief Wrapper around an output driver, adding compression of AJAX responses
+ *
+ *  Responses larger than EMBAJAX_COMPRESSION_THRESHOLD are compressed on the fly (see EMBAJAX_COMPRESSION_WINDOW). Pages are always
+ *  sent uncompressed. If compression is enabled, the provided drivers use this wrapper, automatically (i.e. EmbAJAXOutputDriver is
+ *  an EmbAJAXCompressedOutput). */
+template<class DRIVER> class EmbAJAXCompressedOutput : public DRIVER, private EmbAJAXCompressor {
+public:
+    /** Takes the same parameters as the wrapped driver */
+    template<typename... Args> EmbAJAXCompressedOutput(Args... args) : DRIVER(args...) {}
+    void printHeader(bool html) override {
+        DRIVER::printHeader(html);
+        beginCompression(!html);
+    }
+    void printTypedHeader(const char* content_type) override {
+        DRIVER::printTypedHeader(content_type);
+        beginCompression(false);
+    }
+    void finishContent() override {
+        finishCompression();
+        DRIVER::finishContent();
+    }
+protected:
+    void writeContent(const char* content) override {
+        if (!compressContent(content)) DRIVER::writeContent(content);
+    }
+private:
+    void printCompressed(const char* content) override {
+        DRIVER::writeContent(content);
+    }
+};
+#endif
+
 /** Convenience macro to set up an EmbAJAXPage, without counting the number of elements for the template. See EmbAJAXPage::EmbAJAXPage()
  *  @param name Variable name of the page instance
  *  @param title HTML Title
@@ -253,9 +775,7 @@ private:
 class EmbAJAXStatic : public EmbAJAXBase {
 public:
     /** ctor. Note: Content string is not copied. Don't make this a temporary. */
-    EmbAJAXStatic(const char* content) {
-        _content = content;
-    }
+    constexpr EmbAJAXStatic(const char* content) : _content(content) {}
     void print() const override {
         _driver->printContent(_content);
     }
@@ -276,10 +796,8 @@ public:
      *
      *  @param content_ok Value to show for OK state. May contain HTML markup. Default is "OK" on a green background.
      *  @param content_ok Value to show for broken state. May contain HTML markup. Default is "FAIL" on a green background. */
-    EmbAJAXConnectionIndicator(const char* content_ok = default_ok, const char* content_fail = default_fail) {
-        _content_ok = content_ok;
-        _content_fail = content_fail;
-    }
+    constexpr EmbAJAXConnectionIndicator(const char* content_ok = default_ok, const char* content_fail = default_fail) :
+        _content_ok(content_ok), _content_fail(content_fail) {}
     void print() const override;
     static constexpr const char* default_ok = {"<span style=\"background-color:green;\">OK</span>"};
     static constexpr const char* default_fail = {"<span style=\"background-color:red;\">FAIL</span>"};
@@ -300,8 +818,10 @@ private:
  */
 class EmbAJAXElement : public EmbAJAXBase {
 public:
-    /** @param id: The id for the element. Note that the string is not copied. Do not use a temporary string in this place. Also, do keep it short. */
-    EmbAJAXElement(const char* id);
+    /** @param id: The id for the element. Note that the string is not copied. Do not use a temporary string in this place. Also, do keep it short.
+     *  @param flags: Initial state of flags, in addition to visible and enabled. For use in derived classes. */
+    constexpr EmbAJAXElement(const char* id, byte flags = 0) : EmbAJAXBase(),
+        _flags(flags | 1 << EmbAJAXBase::Visibility | 1 << EmbAJAXBase::Enabledness), _id(id), revision(1) {}
 
     const char* id() const {
         return _id;
@@ -343,29 +863,199 @@ public:
     EmbAJAXElement *toElement() override final {
         return this;
     }
+
+    /** See EmbAJAXBase::maxUpdateSize(). For an element of unknown class (and in this base class), a single HTML text property of
+     *  EMBAJAX_ASSUMED_TEXT_LEN characters is assumed. */
+    static constexpr size_t maxUpdateSize() {
+        return updateSizeBound(sizeof("innerHTML"), EMBAJAX_ASSUMED_TEXT_LEN, true);
+    }
+    /** Helper for implementing maxUpdateSize() in derived classes: Upper bound on the size of an update of the basic properties, and one
+     *  further property.
+     *  @param property_size size of the name of the property, including the terminating '\0'
+     *  @param value_len maximum length of the value
+     *  @param escaped whether the value is HTML escaped (which may take up to five bytes per character)
+     *  The id is assumed to be shorter than EMBAJAX_MAX_ID_LEN. See EmbAJAXBase::maxUpdateSize(). */
+    static constexpr size_t updateSizeBound(size_t property_size, size_t value_len, bool escaped) {
+        return sizeof("," EMBAJAX_NL "{" EMBAJAX_NL "\"id\":" "," EMBAJAX_NL "\"changes\":[" "]" EMBAJAX_NL "}") - 1 + 2 + EMBAJAX_MAX_ID_LEN +
+               sizeof("[\"parentNode.style.display\",\"none\"]" ",[\"disabled\",\"disabled\"]") - 1 +
+               sizeof(",[\"\",\"\"]") - 1 + property_size - 1 + value_len * (escaped ? 5 : 2);
+    }
+
+    /** Mark this element as high priority. If the size of update responses is limited (EmbAJAXPageBase::setMaxResponseSize()),
+     *  changes to high priority elements are always sent first, and are never held back. Use this for few, important values,
+     *  such as alarms. Changes to other elements may be delayed to subsequent polls. */
+    void setHighPriority(bool high=true) {
+        if (high) _flags |= 1 << EmbAJAXBase::HighPriority;
+        else _flags &= ~(1 << EmbAJAXBase::HighPriority);
+    }
+    /** How often changes to an element are sent to the client. See setUpdateClass(). */
+    enum UpdateClass {
+        Normal=0,   ///< The default: Changes are sent on each poll, unless an interval has been set with EmbAJAXPageBase::setUpdateInterval()
+        Slow=1,     ///< Changes are sent every five seconds, by default
+        Realtime=2  ///< Changes are always sent on each poll
+    };
+    /** Set the update class of this element. Changes to elements of the Slow (or a throttled Normal) class are held back, until the
+     *  update interval of the class has passed for the client (see EmbAJAXPageBase::setUpdateInterval()), and are then sent together.
+     *  Use this for values that change often, but need not be shown in realtime, such as a temperature reading, to save bandwidth and
+     *  rendering time for the values that do.
+     *
+     *  @note This is meant for display elements. Value changes sent from the client are handled as usual, but any further change to
+     *        the element made on the server is delayed, too.
+     *  @note For an EmbAJAXHideableContainer, this applies to the visibility of the container, only, not to its children. */
+    void setUpdateClass(UpdateClass update_class) {
+        _flags = (_flags & ~(3 << EmbAJAXBase::UpdateClassBits)) | (update_class << EmbAJAXBase::UpdateClassBits);
+    }
+    UpdateClass updateClass() const {
+        return (UpdateClass) ((_flags >> EmbAJAXBase::UpdateClassBits) & 3);
+    }
 protected:
     void setBasicProperty(uint8_t num, bool status) override;
     bool basicProperty(uint8_t num) const {
         return (_flags & (1 << num));
     }
-    byte _flags;
+    uint16_t _flags;
 template<size_t NUM> friend class EmbAJAXPage;
 friend class EmbAJAXBase;
     const char* _id;
     void setChanged();
     bool changed(uint16_t since);
-    /** Filthy trick to keep (template) implementation out of the header. See EmbAJAXTextInput::print() */
-    void printTextInput(size_t size, const char* value) const;
+    /** Called while sending updates, for elements that are due to be sent, right before checking for changes. Elements that hold back
+     *  changes (see EmbAJAXThrottle), or compute their value on demand (see EmbAJAXLazySpan) call setChanged(), here, as needed.
+     *  Such changes are sent along with the same response. The default implementation does nothing. */
+    virtual void refreshValue() {}
 private:
+    /** Number of bytes that sendUpdates() writes for this element (assuming it has changed) */
+    size_t updateSize() const;
+    /** Call refreshValue(), keeping track of the element being refreshed (see _other_change) */
+    void refresh();
     uint16_t revision;
+    /** The element inside refreshValue(), if any */
+    static EmbAJAXElement* volatile _refreshing;
+    /** Set by any change other than from refreshValue(), i.e. from loop(), if that runs while sending updates (with an asynchronous server) */
+    static volatile bool _other_change;
+    /** Whether changes are held back in the current request (see EmbAJAXTransaction). Sampled once per request, so a transaction committed
+     *  while sending updates does not publish half of its changes. */
+    static bool _held_back;
+};
+
+/** @brief Counter shared between loop(), and request handling
+ *
+ *  With an asynchronous server (EmbAJAXOutputDriverESPAsync), requests are handled in a separate task, which may run at the same time as
+ *  loop() (on the other core of an ESP32). Changes to this counter are atomic. */
+class EmbAJAXSharedCounter {
+public:
+    constexpr EmbAJAXSharedCounter() : _value(0) {}
+    void increment();
+    /** Decrement, unless already 0 */
+    void decrement();
+    uint16_t value() const {
+        return _value;
+    }
+private:
+    volatile uint16_t _value;
+};
+
+/** @brief Group changes to several elements, so clients see either all of them, or none
+ *
+ *  A poll arriving while a group of related elements is being updated (with an asynchronous server, such as ESPAsyncWebServer, this can
+ *  happen at any time) could otherwise see the group half done. Changes made inside a transaction get the same revision, and are held back
+ *  from all clients, until the transaction is committed. Polls in between see the previous state.
+ *
+ *  @code
+ *  EmbAJAXTransaction::begin();
+ *  voltage.setValue(voltage_buf);
+ *  current.setValue(current_buf);
+ *  EmbAJAXTransaction::commit();
+ *  @endcode
+ *
+ *  Alternatively, create an EmbAJAXTransaction object on the stack. The transaction is then committed, when it goes out of scope.
+ *  Transactions may be nested. Changes are published, when the outermost transaction is committed.
+ *
+ *  @note Keep transactions short. Any other change (including those sent from clients), and changes to values computed during the poll
+ *        (see EmbAJAXElement::refreshValue()) are held back, too, while a transaction is open. */
+class EmbAJAXTransaction {
+public:
+    EmbAJAXTransaction() {
+        begin();
+    }
+    ~EmbAJAXTransaction() {
+        commit();
+    }
+    static void begin() {
+        _depth.increment();
+    }
+    static void commit() {
+        _depth.decrement();
+    }
+    /** @returns true, while a transaction is open */
+    static bool open() {
+        return _depth.value() != 0;
+    }
+private:
+    static EmbAJAXSharedCounter _depth;
+};
+
+/** @brief Deadband and rate limit for changes of a numeric element
+ *
+ *  Noisy values, such as ADC readings, would otherwise cause an update to be sent on (almost) every poll, although nobody can see the
+ *  difference. Changes made on the server, that do not exceed the deadband, or that come in faster than the minimum interval, are held
+ *  back. The latest value is always sent, eventually: Changes exceeding the deadband as soon as the minimum interval has passed, smaller
+ *  changes, once the value has settled (i.e. has not changed for settle_time).
+ *
+ *  Each element needs its own throttle:
+ *  @code
+ *  EmbAJAXSlider slider("slider", 0, 4095, 0);
+ *  EmbAJAXThrottle slider_throttle(250, 20);   // at most four updates per second, ignore jitter of up to +/-20
+ *  [...]
+ *  slider.setThrottle(&slider_throttle);
+ *  @endcode
+ *
+ *  Supported by EmbAJAXSlider, EmbAJAXColorPicker, EmbAJAXJoystick, and EmbAJAXMutableSpan::setReading(). For elements with several
+ *  components (such as the channels of a color), the deadband applies to each component. Changes sent by a client are not affected. */
+class EmbAJAXThrottle {
+public:
+    /** @param min_interval minimum interval between two updates in milliseconds
+     *  @param deadband changes of at most this (absolute) amount are held back, until the value has settled
+     *  @param deadband_percent changes of at most this percentage of the previously sent value are held back, until the value has settled.
+     *                          The larger one of deadband, and deadband_percent applies.
+     *  @param settle_time time in milliseconds, after which a value is considered settled, if it has not changed */
+    constexpr EmbAJAXThrottle(uint16_t min_interval, uint16_t deadband=0, uint8_t deadband_percent=0, uint16_t settle_time=1000) :
+        _min_interval(min_interval), _deadband(deadband), _settle_time(settle_time), _deadband_percent(deadband_percent), _pending(None),
+        _sent{0, 0, 0}, _held{0, 0, 0}, _last_sent(0), _last_change(0) {}
+    /** Internal: A new value has been set on the server.
+     *  @returns true, if the change is to be sent, now, false, if it is held back */
+    bool accept(int16_t a, int16_t b=0, int16_t c=0);
+    /** Internal: Called on each poll. @returns true, if a change that has been held back is to be sent, now */
+    bool due();
+    /** Internal: A new value has been received from a client (which need not be sent back) */
+    void sync(int16_t a, int16_t b=0, int16_t c=0);
+    /** @returns true, if any throttle is holding back a change. Such changes become due with time, not with a change in revision. */
+    static bool pending() {
+        return _num_pending.value() != 0;
+    }
+private:
+    enum Pending : uint8_t {
+        None,
+        WithinDeadband,
+        OutsideDeadband
+    };
+    void setPending(Pending pending);
+    static EmbAJAXSharedCounter _num_pending;
+    uint16_t _min_interval;
+    uint16_t _deadband;
+    uint16_t _settle_time;
+    uint8_t _deadband_percent;
+    Pending _pending;
+    int16_t _sent[3];
+    int16_t _held[3];
+    uint32_t _last_sent;
+    uint32_t _last_change;
 };
 
 /** @brief An HTML span element with content that can be updated from the server (not the client) */
 class EmbAJAXMutableSpan : public EmbAJAXElement {
 public:
-    EmbAJAXMutableSpan(const char* id) : EmbAJAXElement(id) {
-        _value = 0;
-    }
+    constexpr EmbAJAXMutableSpan(const char* id) : EmbAJAXElement(id), _value(0), _throttle(0) {}
     void print() const override;
     const char* value(uint8_t which = EmbAJAXBase::Value) const override;
     const char* valueProperty(uint8_t which = EmbAJAXBase::Value) const override;
@@ -378,42 +1068,154 @@ public:
      *                    if false (the default), any "<" and "&" in value will be escaped,
      *                    before rendering on the client, making the string plain but safe. */
     void setValue(const char* value, bool allowHTML = false);
+    /** Set the <span>s content to the text representing a numeric reading, such as a sensor value. If a throttle has been set (see
+     *  setThrottle()), updates are sent according to the reading.
+     *
+     *  @param text the text to show. Note: The string is not copied, so don't make this a temporary. It is shown as plain text.
+     *  @param reading the numeric value represented by text (possibly scaled to fit into 16 bits) */
+    void setReading(const char* text, int16_t reading);
     bool valueNeedsEscaping(uint8_t which=EmbAJAXBase::Value) const override;
+    /** See EmbAJAXBase::maxUpdateSize(). Assumes a content of at most EMBAJAX_ASSUMED_TEXT_LEN characters. */
+    static constexpr size_t maxUpdateSize() {
+        return updateSizeBound(sizeof("innerHTML"), EMBAJAX_ASSUMED_TEXT_LEN, true);
+    }
+    /** Limit the updates caused by setReading(). See EmbAJAXThrottle. setValue() is not affected. @param throttle may be 0 to remove the throttle */
+    void setThrottle(EmbAJAXThrottle *throttle) {
+        _throttle = throttle;
+    }
+protected:
+    void refreshValue() override;
 private:
     const char* _value;
+    EmbAJAXThrottle *_throttle;
+};
+
+/** Function computing the value of an EmbAJAXLazySpan, on demand.
+ *  @param buf buffer to write the value to, as a '\0'-terminated string
+ *  @param size size of buf, including the terminating '\0'
+ *  @param data the pointer passed to EmbAJAXLazySpan (e.g. a variable to format), may be 0 */
+typedef void (*EmbAJAXValueProvider)(char* buf, size_t size, const void* data);
+
+/** EmbAJAXValueProvider to show an int variable. data must point to the variable. */
+void EmbAJAXFormatInt(char* buf, size_t size, const void* data);
+
+/** @brief Abstract base class for EmbAJAXLazySpan. */
+class EmbAJAXLazySpanBase : public EmbAJAXElement {
+public:
+    const char* valueProperty(uint8_t which = EmbAJAXBase::Value) const override;
+    bool valueNeedsEscaping(uint8_t which = EmbAJAXBase::Value) const override;
+    /** Change the function computing the value. See EmbAJAXLazySpan::EmbAJAXLazySpan() */
+    void setProvider(EmbAJAXValueProvider provider, const void* data=0) {
+        _provider = provider;
+        _data = data;
+    }
+protected:
+    constexpr EmbAJAXLazySpanBase(const char* id, EmbAJAXValueProvider provider, const void* data) : EmbAJAXElement(id), _provider(provider), _data(data) {}
+    void print(const char* value) const;
+    /** Compute the value into buf, and copy it to value, if it differs from the value sent, before.
+     *  @param value the value sent, before
+     *  @param buf scratch buffer of the same size */
+    void provideValue(char* value, char* buf, size_t size);
+private:
+    EmbAJAXValueProvider _provider;
+    const void* _data;
+};
+
+/** @brief A text span showing a value that is computed on demand
+ *
+ *  Like EmbAJAXMutableSpan, but rather than setting the value from loop(), you provide a function to compute it. This is called only while
+ *  answering a poll, for which the element is due (see EmbAJAXElement::setUpdateClass()), so it costs nothing, while no client is connected.
+ *  The value is sent only, if it differs from the value computed, before. Use this for values that are expensive to obtain, such as readings
+ *  from I2C sensors:
+ *  @code
+ *  void readTemperature(char* buf, size_t size, const void*) {
+ *      snprintf(buf, size, "%d", sensor.readTemperature());
+ *  }
+ *  EmbAJAXLazySpan<8> temperature("temp", readTemperature);
+ *
+ *  int counter;
+ *  EmbAJAXLazySpan<8> counter_display("counter", EmbAJAXFormatInt, &counter);  // a variable, and a function to format it
+ *  @endcode
+ *
+ *  The template parameter specifies the size of the buffer for the value, including the terminating '\0'. Longer values are truncated.
+ *  The value is shown as plain text. It is computed for the first time, when the first client polls for updates (right after loading the page).
+ *
+ *  @note Responses containing the element are not kept in the response cache (see EMBAJAX_RESPONSE_CACHE), as the value may change at any time. */
+template<size_t SIZE> class EmbAJAXLazySpan : public EmbAJAXLazySpanBase {
+public:
+    /** @param provider the function to compute the value
+     *  @param data passed to the provider, e.g. a pointer to a variable to format */
+    constexpr EmbAJAXLazySpan(const char* id, EmbAJAXValueProvider provider, const void* data=0) : EmbAJAXLazySpanBase(id, provider, data), _value{} {}
+    void print() const override {
+        EmbAJAXLazySpanBase::print(_value);
+    }
+    const char* value(uint8_t which = EmbAJAXBase::Value) const override {
+        if (which == EmbAJAXBase::Value) return _value;
+        return EmbAJAXElement::value(which);
+    }
+    static constexpr size_t maxUpdateSize() {
+        return updateSizeBound(sizeof("innerHTML"), SIZE - 1, true);
+    }
+protected:
+    void refreshValue() override {
+        char buf[SIZE];
+        provideValue(_value, buf, SIZE);
+    }
+private:
+    char _value[SIZE];
+};
+
+/** @brief Abstract base class for EmbAJAXTextInput. */
+class EmbAJAXTextInputBase : public EmbAJAXElement {
+public:
+    const char* valueProperty(uint8_t which = EmbAJAXBase::Value) const override;
+    /** Set a function to be called, when the text was changed in a client. The function is passed the element, the previous, and the new text.
+     *  It is called before the change_callback of the page (see EmbAJAXPage::handleRequest()). @param callback may be 0 to remove the callback */
+    void setChangeCallback(void (*callback)(EmbAJAXTextInputBase*, const char* old_value, const char* new_value)) {
+        _change_callback = callback;
+    }
+protected:
+    constexpr EmbAJAXTextInputBase(const char* id) : EmbAJAXElement(id), _change_callback(0) {}
+    void print(size_t size, const char* value) const;
+    void setValue(char* buf, size_t size, const char* value);
+    /** Receive the value into value, and call the change callback, if it differs from the previous one.
+     *  @param buf scratch buffer of the same size (for the previous value) */
+    void updateFromDriverArg(char* value, char* buf, size_t size, const char* argname);
+    void (*_change_callback)(EmbAJAXTextInputBase*, const char*, const char*);
 };
 
 /** @brief A text input field.
  *
  *  A text input field. The template parameter specifies the size (i.e. maximum number of chars)
- *  of the input field.
+ *  of the input field. Most functions are implemented in the base class EmbAJAXTextInputBase.
  *
  *  @note To limit the rate, and avoid conflicting update-conditions, when typing into the text field in the client,
- *        changes are sent to the server one second after the last key was pressed. This worked for me, best. */
-template<size_t SIZE> class EmbAJAXTextInput : public EmbAJAXElement {
+ *        changes are sent to the server one second after the last key was pressed. This worked for me, best.
+ *  @note With drivers that buffer the request (EmbAJAXOutputDriverESPAsync, EmbAJAXOutputDriverRawSocket), values received from the
+ *        client are cut short to fit into EMBAJAX_MAX_REQUEST_LEN, after URL encoding (up to 12 bytes per non-ASCII character). For
+ *        large inputs, add 3 * SIZE to EMBAJAX_MAX_REQUEST_LEN (12 * SIZE, to be safe for any text). The other arguments of a request
+ *        take about 100 bytes (more with EMBAJAX_VIEWPORT_UPDATES). */
+template<size_t SIZE> class EmbAJAXTextInput : public EmbAJAXTextInputBase {
 public:
-    EmbAJAXTextInput(const char* id) : EmbAJAXElement(id) {
-        _value[0] = '\0';
-    }
+    constexpr EmbAJAXTextInput(const char* id) : EmbAJAXTextInputBase(id), _value{} {}
     void print() const override {
-        EmbAJAXElement::printTextInput(SIZE, _value);
+        EmbAJAXTextInputBase::print(SIZE, _value);
     }
     const char* value(uint8_t which = EmbAJAXBase::Value) const override {
         if (which == EmbAJAXBase::Value) return _value;
         return EmbAJAXElement::value(which);
     }
-    const char* valueProperty(uint8_t which = EmbAJAXBase::Value) const override {
-        if (which == EmbAJAXBase::Value) return "value";
-        return EmbAJAXElement::valueProperty(which);
-    }
     /** Set the text inputs content to the given value. Note: In this particular case, the value passed _is_ copied,
      *  you can safely pass a temporary string. */
     void setValue(const char* value) {
-        strncpy(_value, value, SIZE);
-        setChanged();
+        EmbAJAXTextInputBase::setValue(_value, SIZE, value);
     }
     void updateFromDriverArg(const char* argname) override {
-        _driver->getArg(argname, _value, SIZE);
+        char buf[SIZE];
+        EmbAJAXTextInputBase::updateFromDriverArg(_value, buf, SIZE, argname);
+    }
+    static constexpr size_t maxUpdateSize() {
+        return updateSizeBound(sizeof("value"), SIZE - 1, false);
     }
 protected:
     char _value[SIZE];
@@ -422,7 +1224,7 @@ protected:
 /** @brief An HTML span element with content that can be updated from the server (not the client) */
 class EmbAJAXSlider : public EmbAJAXElement {
 public:
-    EmbAJAXSlider(const char* id, int16_t min, int16_t max, int16_t initial);
+    constexpr EmbAJAXSlider(const char* id, int16_t min, int16_t max, int16_t initial) : EmbAJAXElement(id), _min(min), _max(max), _value(initial), _throttle(0), _change_callback(0) {}
     void print() const override;
     const char* value(uint8_t which = EmbAJAXBase::Value) const override;
     const char* valueProperty(uint8_t which = EmbAJAXBase::Value) const override;
@@ -431,8 +1233,24 @@ public:
         return _value;
     }
     void updateFromDriverArg(const char* argname) override;
+    static constexpr size_t maxUpdateSize() {
+        return updateSizeBound(sizeof("value"), sizeof("-32768") - 1, false);
+    }
+    /** Limit the updates caused by setValue(). See EmbAJAXThrottle. @param throttle may be 0 to remove the throttle */
+    void setThrottle(EmbAJAXThrottle *throttle) {
+        _throttle = throttle;
+    }
+    /** Set a function to be called, when the slider was moved in a client, with the previous, and the new value.
+     *  It is called before the change_callback of the page (see EmbAJAXPage::handleRequest()). @param callback may be 0 to remove the callback */
+    void setChangeCallback(void (*callback)(EmbAJAXSlider*, int16_t old_value, int16_t new_value)) {
+        _change_callback = callback;
+    }
+protected:
+    void refreshValue() override;
 private:
     int16_t _min, _max, _value;
+    EmbAJAXThrottle *_throttle;
+    void (*_change_callback)(EmbAJAXSlider*, int16_t, int16_t);
 };
 
 /** @brief A color picker element (\<input type="color">) */
@@ -442,7 +1260,7 @@ public:
      *  @param r Initial value for red
      *  @param g Initial value for green
      *  @param b Initial value for blue */
-    EmbAJAXColorPicker(const char* id, uint8_t r, uint8_t g, uint8_t b);
+    constexpr EmbAJAXColorPicker(const char* id, uint8_t r, uint8_t g, uint8_t b) : EmbAJAXElement(id), _r(r), _g(g), _b(b), _throttle(0), _change_callback(0) {}
     void print() const override;
     const char* value(uint8_t which = EmbAJAXBase::Value) const override;
     const char* valueProperty(uint8_t which = EmbAJAXBase::Value) const override;
@@ -451,8 +1269,27 @@ public:
     uint8_t green() const;
     uint8_t blue() const;
     void updateFromDriverArg(const char* argname) override;
+    static constexpr size_t maxUpdateSize() {
+        return updateSizeBound(sizeof("value"), sizeof("#rrggbb") - 1, false);
+    }
+    /** Limit the updates caused by setColor(). See EmbAJAXThrottle. The deadband applies to each channel. @param throttle may be 0 to remove the throttle */
+    void setThrottle(EmbAJAXThrottle *throttle) {
+        _throttle = throttle;
+    }
+    /** Set a function to be called, when a color was picked in a client. The previous, and the new color are passed as 0xRRGGBB.
+     *  It is called before the change_callback of the page (see EmbAJAXPage::handleRequest()). @param callback may be 0 to remove the callback */
+    void setChangeCallback(void (*callback)(EmbAJAXColorPicker*, uint32_t old_rgb, uint32_t new_rgb)) {
+        _change_callback = callback;
+    }
+protected:
+    void refreshValue() override;
 private:
+    uint32_t rgb() const {
+        return ((uint32_t) _r << 16) | ((uint32_t) _g << 8) | _b;
+    }
     uint8_t _r, _g, _b;
+    EmbAJAXThrottle *_throttle;
+    void (*_change_callback)(EmbAJAXColorPicker*, uint32_t, uint32_t);
 };
 
 /** @brief A push-button.
@@ -462,7 +1299,8 @@ class EmbAJAXPushButton : public EmbAJAXElement {
 public:
     /** @param label: @see setText(). HTML is allowed, here.
      *  @param callback Called when the button was clicked in the UI (with a pointer to the button as parameter) */
-    EmbAJAXPushButton(const char* id, const char* label, void (*callback)(EmbAJAXPushButton*));
+    constexpr EmbAJAXPushButton(const char* id, const char* label, void (*callback)(EmbAJAXPushButton*)) :
+        EmbAJAXElement(id, 1 << EmbAJAXBase::HTMLAllowed), _callback(callback), _label(label) {}
     void print() const override;
     /** Change the button text
      *
@@ -477,6 +1315,10 @@ public:
     const char* valueProperty(uint8_t which = EmbAJAXBase::Value) const override;
     bool valueNeedsEscaping(uint8_t which=EmbAJAXBase::Value) const override;
     void updateFromDriverArg(const char* argname) override;
+    /** See EmbAJAXBase::maxUpdateSize(). Assumes a label of at most EMBAJAX_ASSUMED_TEXT_LEN characters. */
+    static constexpr size_t maxUpdateSize() {
+        return updateSizeBound(sizeof("innerHTML"), EMBAJAX_ASSUMED_TEXT_LEN, true);
+    }
 protected:
     void (*_callback)(EmbAJAXPushButton*);
     const char* _label;
@@ -497,7 +1339,8 @@ public:
      *                        If no ping has been received within timeout, status() will return MaybePressed.
      *  @param callback Called when the button was clicked or relased in the UI (with a pointer to the button as parameter)
      *                  @em Not called, when a ping has timed out. */
-    EmbAJAXMomentaryButton(const char* id, const char* label, uint16_t timeout=600, void (*callback)(EmbAJAXPushButton*)=0);
+    constexpr EmbAJAXMomentaryButton(const char* id, const char* label, uint16_t timeout=600, void (*callback)(EmbAJAXPushButton*)=0) :
+        EmbAJAXPushButton(id, label, callback), latest_ping(0), _timeout(timeout) {}
     void print() const override;
     enum Status {
         Pressed,
@@ -527,7 +1370,8 @@ public:
     *               will cause the <label/>-element to be omitted (useful with some CSS definitions).
     *  @param checked If true, the checkbox will be initially checked. @see setChecked().
     */
-    EmbAJAXCheckButton(const char* id, const char* label=nullptr, bool checked=false);
+    constexpr EmbAJAXCheckButton(const char* id, const char* label=nullptr, bool checked=false) : EmbAJAXElement(id), _checked(checked), _label(label),
+        _change_callback(0), radiogroup(nullptr) {}
     void print() const override;
     const char* value(uint8_t which = EmbAJAXBase::Value) const override;
     const char* valueProperty(uint8_t which = EmbAJAXBase::Value) const override;
@@ -536,48 +1380,70 @@ public:
         return _checked;
     }
     void updateFromDriverArg(const char* argname) override;
+    static constexpr size_t maxUpdateSize() {
+        return updateSizeBound(sizeof("checked"), sizeof("true") - 1, false);
+    }
+    /** Set a function to be called, when the button was checked or unchecked in a client, with the previous, and the new state.
+     *  It is called before the change_callback of the page (see EmbAJAXPage::handleRequest()). For the buttons of a radio group, see also
+     *  EmbAJAXRadioGroupBase::setChangeCallback(). @param callback may be 0 to remove the callback */
+    void setChangeCallback(void (*callback)(EmbAJAXCheckButton*, bool old_checked, bool new_checked)) {
+        _change_callback = callback;
+    }
 private:
     bool _checked;
     const char* _label;
+    void (*_change_callback)(EmbAJAXCheckButton*, bool, bool);
 template<size_t NUM> friend class EmbAJAXRadioGroup;
-    EmbAJAXCheckButton() : EmbAJAXElement("") {};
+friend class EmbAJAXRadioGroupBase;
+    EmbAJAXCheckButton() : EmbAJAXElement(""), _checked(false), _label(nullptr), _change_callback(0), radiogroup(nullptr) {};
+    /** Radio button. The id is stored in the group, see EmbAJAXRadioGroup */
+    EmbAJAXCheckButton(const char* id, const char* label, bool checked, EmbAJAXRadioGroupBase* group) :
+        EmbAJAXElement(id), _checked(checked), _label(label), _change_callback(0), radiogroup(group) {}
     EmbAJAXRadioGroupBase* radiogroup;
 };
 
-/** @brief abstract base for EmbAJAXRadioGroup, needed for internal reasons. */
-class EmbAJAXRadioGroupBase {
+/** @brief Base class for groups of objects
+ *
+ *  Implementation of EmbAJAXContainer, which does not depend on the number of children. */
+class EmbAJAXContainerBase : public EmbAJAXBase {
+public:
+    void print() const override;
+    bool sendUpdates(uint16_t since, bool first) override;
+    /** Recursively look for a child (hopefully, there is only one) of the given id, and return a pointer to it. */
+    EmbAJAXElement* findChild(const char*id) const override final;
+    /** Not available, as the children are not known at compile time. Use EmbAJAXTypedContainer, or list the children, individually.
+     *  See EmbAJAXPageBase::maxResponseSize(). */
+    static size_t maxUpdateSize() = delete;
+    static size_t childrenFootprint() = delete;
 protected:
-    EmbAJAXRadioGroupBase() {};
-friend class EmbAJAXCheckButton;
-    virtual void selectButton(EmbAJAXCheckButton* which) = 0;
-    const char* _name;
+    constexpr EmbAJAXContainerBase(EmbAJAXBase** children, size_t num) : EmbAJAXBase(), _children(children), _num(num) {}
+    void setBasicProperty(uint8_t num, bool status) override;
+friend class EmbAJAXHideableContainerBase;
+    EmbAJAXBase** _children;
+    size_t _num;
 };
 
-/** @brief Base class for groups of objects */
-template<size_t NUM> class EmbAJAXContainer : public EmbAJAXBase {
+/** @brief A group of objects
+ *
+ *  All functions are implemented in the base class EmbAJAXContainerBase, you'll only use this class for the constructor. */
+template<size_t NUM> class EmbAJAXContainer : public EmbAJAXContainerBase {
 public:
-    EmbAJAXContainer(EmbAJAXBase *children[NUM]) : EmbAJAXBase() {
-        _children = children;
-    }
-    void print() const override {
-        EmbAJAXBase::printChildren(_children, NUM);
-    }
-    bool sendUpdates(uint16_t since, bool first) override {
-        return EmbAJAXBase::sendUpdates(_children, NUM, since, first);
-    }
-    /** Recursively look for a child (hopefully, there is only one) of the given id, and return a pointer to it. */
-    EmbAJAXElement* findChild(const char*id) const override final {
-        return EmbAJAXBase::findChild(_children, NUM, id);
-    }
+    constexpr EmbAJAXContainer(EmbAJAXBase *children[NUM]) : EmbAJAXContainerBase(children, NUM) {}
+};
+
+/** @brief Abstract base class for EmbAJAXHideableContainer. */
+class EmbAJAXHideableContainerBase : public EmbAJAXElement {
+public:
+    void print() const override;
+    EmbAJAXElement* findChild(const char* id) const override;
+    bool sendUpdates(uint16_t since, bool first) override;
+    /** Not available, as the children are not known at compile time. See EmbAJAXContainerBase::maxUpdateSize() */
+    static size_t maxUpdateSize() = delete;
+    static size_t childrenFootprint() = delete;
 protected:
-    void setBasicProperty(uint8_t num, bool status) override {
-        for (uint8_t i = 0; i < NUM; ++i) {
-            _children[i]->setBasicProperty(num, status);
-        }
-    }
-template<size_t> friend class EmbAJAXHideableContainer;
-    EmbAJAXContainer() {};
-    EmbAJAXBase** _children;
+    constexpr EmbAJAXHideableContainerBase(const char* id, EmbAJAXBase** children, size_t num) : EmbAJAXElement(id), _childlist(children, num) {}
+    void setBasicProperty(uint8_t num, bool status) override;
+    EmbAJAXContainerBase _childlist;
 };
 
 /** @brief A list of objects that can be hidden, completely
@@ -591,91 +1457,77 @@ template<size_t> friend class EmbAJAXHideableContainer;
  *  You do _not_ need this class to hide an EmbAJAXContainer that contains only EmbAJAXElement
  *  derived objects, or standalone EmbAJAXElement objects.
  *
+ *  While the container is hidden, changes to its children are not sent to the client. They are sent in one go, once the
+ *  container is shown, again. This makes it cheap to keep large, but rarely shown panels (e.g. advanced settings) on a page.
+ *
  *  @note This is _not_ a derived class of EmbAJAXContainer, to avoid adding virtual
  *        inheritance just for this. */
-template<size_t NUM> class EmbAJAXHideableContainer : public EmbAJAXElement {
+template<size_t NUM> class EmbAJAXHideableContainer : public EmbAJAXHideableContainerBase {
 public:
-    EmbAJAXHideableContainer(const char* id, EmbAJAXBase *children[NUM]) : EmbAJAXElement(id) {
-        _childlist = EmbAJAXContainer<NUM>(children);
-    }
-    void print() const override {
-        _driver->printFormatted("<div id=", HTML_QUOTED_STRING(_id), ">");
-        _childlist.print();
-        _driver->printContent("</div>");
+    constexpr EmbAJAXHideableContainer(const char* id, EmbAJAXBase *children[NUM]) : EmbAJAXHideableContainerBase(id, children, NUM) {}
+};
+
+/** @brief Abstract base class for EmbAJAXRadioGroup. */
+class EmbAJAXRadioGroupBase : public EmbAJAXContainerBase {
+public:
+    /** Select / check the option at the given index. All other options in this radio group will become deselected. */
+    void selectOption(uint8_t num);
+    /** @returns the index of the currently selected option. May be > NUM, if no option is selected. */
+    uint8_t selectedOption() const {
+        return _current_option;
     }
-    EmbAJAXElement* findChild(const char* id) const override {
-        return _childlist.findChild(id);
+    /** @returns a representation of an individual option element. You can use this to insert the individual buttons
+     *           at arbitrary positions in the page layout. */
+    EmbAJAXBase* button(uint8_t num) {
+        if (num < _num) return (_children[num]);
+        return 0;
     }
-    bool sendUpdates(uint16_t since, bool first) override {
-        bool sent = EmbAJAXElement::sendUpdates(since, first);
-        bool sent2 = _childlist.sendUpdates(since, first && !sent);
-        return sent || sent2;
+    /** Set a function to be called, when a different option was selected in a client, with the previous, and the new option index (see selectedOption()).
+     *  It is called before the change_callback of the page (see EmbAJAXPage::handleRequest()). @param callback may be 0 to remove the callback */
+    void setChangeCallback(void (*callback)(EmbAJAXRadioGroupBase*, uint8_t old_option, uint8_t new_option)) {
+        _change_callback = callback;
     }
 protected:
-    void setBasicProperty(uint8_t num, bool status) override {
-        EmbAJAXElement::setBasicProperty(num, status);
-        _childlist.setBasicProperty(num, status);
-    }
-    EmbAJAXContainer<NUM> _childlist;
+    EmbAJAXRadioGroupBase(const char* id_base, EmbAJAXBase** buttonpointers, size_t num, uint8_t selected_option) :
+        EmbAJAXContainerBase(buttonpointers, num), _name(id_base), _current_option(selected_option), _change_callback(0) {}
+    void initButtons(EmbAJAXCheckButton* buttons, char (*childids)[EMBAJAX_MAX_ID_LEN], const char* const* options);
+friend class EmbAJAXCheckButton;
+    void selectButton(EmbAJAXCheckButton* which);
+    const char* _name;
+    int8_t _current_option;
+    void (*_change_callback)(EmbAJAXRadioGroupBase*, uint8_t, uint8_t);
 };
 
 /** @brief A set of radio buttons (mutally exclusive buttons), e.g. for on/off, or low/mid/high, etc.
  *
  *  You can insert either the whole group into an EmbAJAXPage at once, or - for more flexbile
  *  layouting - retrieve the individual buttons using() button, and insert them into the page
- *  as independent elements. */
-template<size_t NUM> class EmbAJAXRadioGroup : public EmbAJAXContainer<NUM>, public EmbAJAXRadioGroupBase {
+ *  as independent elements. Most functions of interest are implemented in the base class EmbAJAXRadioGroupBase.
+ *
+ *  @note Unlike most other elements, radio groups cannot be constant-initialized: The constructor composes the ids of the buttons
+ *        (id_base0, id_base1, ...) into EMBAJAX_MAX_ID_LEN bytes of RAM per option, and sets up the buttons, at startup. Each button
+ *        needs a stable id (it is used in responses, traces, and for viewport updates), and may be placed on a page on its own. */
+template<size_t NUM> class EmbAJAXRadioGroup : public EmbAJAXRadioGroupBase {
 public:
     /** ctor.
      *  @param id_base the "base" id. Internally, radio buttons with id_s id_base0, id_base1, etc. will be created.
      *  @param options labels for the options. Note: The @em array of options may be a temporary, but the option-strings themselves will have to be persistent!
      *  @param selected_option index of the default option. 0 by default, for the first option, may be > NUM, for
      *                         no option selected by default. */
-    EmbAJAXRadioGroup(const char* id_base, const char* options[NUM], uint8_t selected_option = 0) : EmbAJAXContainer<NUM>(), EmbAJAXRadioGroupBase() {
-        for (uint8_t i = 0; i < NUM; ++i) {
-            char* childid = childids[i];
-            strncpy(childid, id_base, EMBAJAX_MAX_ID_LEN-4);
-            itoa(i, &(childid[strlen(childid)]), 10);
-            buttons[i] = EmbAJAXCheckButton(childid, options[i], i == selected_option);
-            buttons[i].radiogroup = this;
-            buttonpointers[i] = &buttons[i];
-        }
-        _current_option = selected_option;
-         EmbAJAXContainer<NUM>::_children = buttonpointers;  // Hm, why do I need to specify EmbAJAXContainer<NUM>::, explicitly?
-        _name = id_base;
-    }
-    /** Select / check the option at the given index. All other options in this radio group will become deselected. */
-    void selectOption(uint8_t num) {
-        for (uint8_t i = 0; i < NUM; ++i) {
-            buttons[i].setChecked(i == num);
-        }
-        _current_option = num;  // NOTE: might be outside of range, but that's ok, signifies "none selected"
+    EmbAJAXRadioGroup(const char* id_base, const char* options[NUM], uint8_t selected_option = 0) : EmbAJAXRadioGroupBase(id_base, buttonpointers, NUM, selected_option) {
+        initButtons(buttons, childids, options);
     }
-    /** @returns the index of the currently selected option. May be > NUM, if no option is selected. */
-    uint8_t selectedOption() const {
-        return _current_option;
+    static constexpr size_t maxUpdateSize() {
+        return NUM * EmbAJAXCheckButton::maxUpdateSize();
     }
-    /** @returns a representation of an individual option element. You can use this to insert the individual buttons
-     *           at arbitrary positions in the page layout. */
-    EmbAJAXBase* button(uint8_t num) {
-        if (num < NUM) return (&buttons[num]);
+    /** The buttons are allocated inside the group */
+    static constexpr size_t childrenFootprint() {
         return 0;
     }
 private:
     EmbAJAXCheckButton buttons[NUM]; /** NOTE: Internally, the radio groups allocates individual check buttons. This is the storage space for those. */
     EmbAJAXBase* buttonpointers[NUM];
     char childids[NUM][EMBAJAX_MAX_ID_LEN];
-    int8_t _current_option;
-    void selectButton(EmbAJAXCheckButton* which) override {
-        _current_option = -1;
-        for (uint8_t i = 0; i < NUM; ++i) {
-            if (which == buttonpointers[i]) {
-                _current_option = i;
-            } else {
-                buttons[i].setChecked(false);
-            }
-        }
-    }
 };
 
 /** @brief Abstract base class for EmbAJAXOptionSelect. */
@@ -688,12 +1540,22 @@ public:
     const char* value(uint8_t which = EmbAJAXBase::Value) const override;
     const char* valueProperty(uint8_t which = EmbAJAXBase::Value) const override;
     void updateFromDriverArg(const char* argname) override;
+    static constexpr size_t maxUpdateSize() {
+        return updateSizeBound(sizeof("value"), sizeof("255") - 1, false);
+    }
+    /** Set a function to be called, when a different option was selected in a client, with the previous, and the new option index.
+     *  It is called before the change_callback of the page (see EmbAJAXPage::handleRequest()). @param callback may be 0 to remove the callback */
+    void setChangeCallback(void (*callback)(EmbAJAXOptionSelectBase*, uint8_t old_option, uint8_t new_option)) {
+        _change_callback = callback;
+    }
 protected:
     EmbAJAXOptionSelectBase(const char*id, uint8_t current_option) : EmbAJAXElement(id) {
         _current_option = current_option;
+        _change_callback = 0;
     };
     void print(const char* const* _labels, uint8_t NUM) const;
     uint8_t _current_option;
+    void (*_change_callback)(EmbAJAXOptionSelectBase*, uint8_t, uint8_t);
 };
 
 /** @brief Drop-down list of selectable options
@@ -718,6 +1580,47 @@ private:
     const char* _labels[NUM];
 };
 
+/** @brief Information on a client of a page
+ *
+ *  See EmbAJAXPageBase::clientSession(). Clients are identified by a random token, generated by the page script on each page load,
+ *  i.e. reloading the page starts a new session. */
+struct EmbAJAXClientSession {
+    uint16_t id;            ///< token of the client (0 for an unused slot)
+    uint16_t revision;      ///< revision known to the client, as of its latest request
+    uint32_t last_request;  ///< time of the latest request served (millis())
+    uint16_t interval;      ///< average interval between requests in ms (moving average over the last few requests)
+    uint16_t requests;      ///< number of requests served (stops counting at 65535)
+    uint32_t bytes_sent;    ///< total size of the responses sent (excluding HTTP headers)
+    bool blocked;           ///< see EmbAJAXPageBase::blockClient()
+};
+
+#if EMBAJAX_METRICS
+/** @brief Latency of requests, as seen by the clients of a page
+ *
+ *  See EmbAJAXPageBase::clientLatency(). Each client measures the time from sending a request until the response has arrived (including
+ *  network delays), and the time a value change has waited in its queue before being sent (due to the min_interval of the page, or a request
+ *  still in progress). The measurement is reported along with the next request. Times are in milliseconds, and counted in histogram buckets.
+ *  See bucketLimit(). */
+struct EmbAJAXClientLatency {
+    enum {
+        Buckets = 8
+    };
+    uint32_t samples;               ///< number of requests reported
+    uint32_t round_trip[Buckets];   ///< histogram of round trip times
+    uint32_t round_trip_sum;        ///< total of round trip times
+    uint32_t queue_wait[Buckets];   ///< histogram of the times requests have been waiting to be sent (0 for polls)
+    uint32_t queue_wait_sum;        ///< total of queue wait times
+    /** Upper limit (in milliseconds) of the given histogram bucket. The last bucket has no limit. */
+    static uint16_t bucketLimit(uint8_t bucket);
+    /** Average round trip time in milliseconds, or 0, if nothing has been reported */
+    uint16_t averageRoundTrip() const {
+        return samples ? round_trip_sum / samples : 0;
+    }
+    /** Add a report from a client */
+    void record(uint16_t round_trip_ms, uint16_t queue_wait_ms);
+};
+#endif
+
 /** @brief Absrract internal helper class
  *
  * Needed for internal reasons. Refer to EmbAJAXPage, instead. */
@@ -725,6 +1628,139 @@ class EmbAJAXPageBase {
 public:
     virtual void handleRequest(void (*change_callback)()=0) = 0;
     virtual void printPage() = 0;
+    /** Returns true if a client seems to be connected (connected clients should send a ping at least once per second; by default this
+     *  function returns whether a ping has been seen within the last 5000 ms.
+     *  @param latency_ms Number of milliseconds to consider as maximum silence period for an active connection */
+    bool hasActiveClient(uint64_t latency_ms=5000) const {
+        return(_latest_ping && (_latest_ping + latency_ms > millis()));
+    }
+    /** Limit the size of update responses (approximately, the protocol overhead is not counted).
+     *
+     *  By default, each response contains all pending changes, which, after a burst of changes, can make a single response arbitrarily
+     *  large and slow. If a limit is set, changes that do not fit are held back, and sent in subsequent polls (which the client will send
+     *  without further delay). Changes to high priority elements (see EmbAJAXElement::setHighPriority()) are always sent first, and in full,
+     *  other changes follow in page order. Note that at least one regular change is sent in each response, even if it exceeds the limit
+     *  on its own.
+     *
+     *  @param max_size maximum size in bytes. 0 (the default) for no limit. */
+    void setMaxResponseSize(uint16_t max_size) {
+        _max_response_size = max_size;
+    }
+    /** Tell clients how often to poll for updates, while idle.
+     *
+     *  By default, clients poll once per second, backing off to once every three seconds while nothing changes, and to once every 30 seconds
+     *  while the page is not visible. Setting an interval overrides the former (but not the latter), and is sent along with each response, so it
+     *  can be adjusted at any time, e.g. to slow clients down, while the device is busy, or to speed them up, while values are changing, quickly.
+     *  Client events are always sent immediately (subject to the min_interval of the page), regardless of this setting.
+     *
+     *  @note If setting an interval longer than a few seconds, remember to adjust the latency_ms parameter of hasActiveClient(), accordingly.
+     *  @param ms polling interval in milliseconds, or 0 (the default) for automatic */
+    void setPollInterval(uint16_t ms) {
+        _poll_interval = ms;
+    }
+    /** Set how often changes to elements of the given update class (see EmbAJAXElement::setUpdateClass()) are sent to each client.
+     *  By default, Normal elements are sent on each poll, while Slow elements are sent every 5000 ms. The interval is counted per
+     *  client, and changes are sent on the first poll after it has passed, so the effective interval also depends on the polling interval.
+     *
+     *  @param update_class EmbAJAXElement::Normal or EmbAJAXElement::Slow. Realtime elements are always sent.
+     *  @param ms minimum interval in milliseconds */
+    void setUpdateInterval(EmbAJAXElement::UpdateClass update_class, uint16_t ms) {
+        if (update_class < EmbAJAXElement::Realtime) _update_interval[update_class] = ms;
+    }
+    /** Limit the rate of polls served, to keep many clients (e.g. a dashboard left open on several devices) from saturating the device.
+     *
+     *  Excess polls are answered with a short "retry after" reply, which the client obeys before polling again. Requests carrying a
+     *  value change from the client are never turned away, so controls stay responsive.
+     *
+     *  @param max_polls_per_second maximum number of polls to serve per second, across all clients. 0 (the default) for no limit.
+     *  @param min_client_interval minimum interval in milliseconds between two polls served to a single client. 0 (the default) for no limit.
+     *         Only the EMBAJAX_MAX_SESSIONS most recent clients are tracked for this. */
+    void setAdmissionLimits(uint8_t max_polls_per_second, uint16_t min_client_interval=0) {
+        _max_polls = max_polls_per_second;
+        _min_client_interval = min_client_interval;
+    }
+    /** Number of clients that have sent a request within the given period. Note that at most EMBAJAX_MAX_SESSIONS clients are tracked.
+     *  See also hasActiveClient(). */
+    uint8_t activeClients(uint32_t latency_ms=5000) const;
+    /** Information on the client tracked in the given slot, such as the time of its latest request, its request rate, and the traffic caused.
+     *  At most EMBAJAX_MAX_SESSIONS clients are tracked. If further clients show up, the least recently seen one is dropped.
+     *
+     *  @code
+     *  for (uint8_t i = 0; i < EMBAJAX_MAX_SESSIONS; ++i) {
+     *      const EmbAJAXClientSession *session = page.clientSession(i);
+     *      if (session && session->interval < 200) page.blockClient(i);  // polling much faster than the page script does
+     *  }
+     *  @endcode
+     *
+     *  @param slot 0 to EMBAJAX_MAX_SESSIONS-1
+     *  @returns 0, if the slot is not in use */
+    const EmbAJAXClientSession* clientSession(uint8_t slot) const;
+    /** Number of revisions (i.e. rounds of changes on the server) the given client has missed since its latest request. */
+    uint16_t clientLag(const EmbAJAXClientSession *session) const;
+    /** Refuse polls from the client in the given slot (see clientSession()), e.g. because it causes too much load. The client will be
+     *  told to retry after 30 seconds, each time. Value changes sent from the client are still handled. */
+    void blockClient(uint8_t slot, bool blocked=true);
+    /** Upper bound on the size of an update response (a full resync, i.e. all elements changed), for a page containing the given
+     *  elements, at compile time. Pass pointers to all elements on the page. Containers, other than EmbAJAXRadioGroup, and EmbAJAXTypedContainer,
+     *  cannot be passed, as their children are not known at compile time, but their children can be passed, individually. The bound assumes
+     *  no limit set with setMaxResponseSize() (which does not affect high priority elements), and ids shorter than EMBAJAX_MAX_ID_LEN. For an EmbAJAXTypedPage, use
+     *  EmbAJAXTypedPage::maxResponseSize(), instead.
+     *
+     *  @code
+     *  static_assert(EmbAJAXPageBase::maxResponseSize(&check, &slider, &display) < 1460, "Page does not fit into a single TCP segment");
+     *  @endcode */
+    template<typename T, typename... Ts> static constexpr size_t maxResponseSize(const T*, Ts... elements) {
+        return T::maxUpdateSize() + maxResponseSize(elements...);
+    }
+    /** Size of an update response, without any elements. See maxResponseSize() */
+    static constexpr size_t maxResponseSize() {
+        return sizeof("{\"updates\":[" EMBAJAX_NL EMBAJAX_NL "]," EMBAJAX_NL "\"revision\":" "65535" "," EMBAJAX_NL "\"resume\":\"" "65535,65535,255" "\""
+                      "," EMBAJAX_NL "\"synced\":" "255" "," EMBAJAX_NL "\"next_poll_ms\":" "65535" "}" EMBAJAX_NL) - 1;
+    }
+#if EMBAJAX_METRICS
+    /** Histograms of the latency of requests, as measured by the clients (i.e. including network delays), cumulative for all clients.
+     *  Available, unless EMBAJAX_METRICS is set to 0.
+     *
+     *  @code
+     *  if (page.clientLatency().averageRoundTrip() > 500) page.setPollInterval(3000);  // network is struggling, ease off
+     *  @endcode */
+    const EmbAJAXClientLatency& clientLatency() const {
+        return _client_latency;
+    }
+    /** Reset the histograms returned by clientLatency(), e.g. to look at recent reports, only */
+    void resetClientLatency() {
+        _client_latency = EmbAJAXClientLatency();
+    }
+#endif
+protected:
+friend class EmbAJAXBase;
+    constexpr EmbAJAXPageBase(const char* title, const char* header_add, uint16_t min_interval) :
+        _title(title ? title : EmbAJAXBase::null_string), _header_add(header_add ? header_add : EmbAJAXBase::null_string), _min_interval(min_interval) {}
+    const char* _title;
+    const char* _header_add;
+    uint16_t _min_interval;
+    uint16_t _max_response_size = 0;
+    uint16_t _poll_interval = 0;
+    uint16_t _update_interval[2] = {0, 5000};
+    uint8_t _max_polls = 0;
+    uint8_t _polls = 0;
+    uint16_t _min_client_interval = 0;
+    uint32_t _poll_window = 0;
+#if EMBAJAX_MAX_SESSIONS > 0
+    EmbAJAXClientSession _sessions[EMBAJAX_MAX_SESSIONS] = {};
+#endif
+#if EMBAJAX_METRICS
+    EmbAJAXClientLatency _client_latency = {};
+#endif
+    /** Find the session of the client with the given token, replacing the least recently seen session, if needed.
+     *  @returns 0, if the client did not send a token, or sessions are disabled */
+    EmbAJAXClientSession* findSession(uint16_t id);
+    /** Record a request served to the given client */
+    void updateSession(EmbAJAXClientSession *session, uint16_t revision, uint32_t bytes_sent);
+    /** Check the admission limits for a poll from the given client (may be 0).
+     *  @returns 0, if the poll should be served, the number of milliseconds after which to retry, otherwise. */
+    uint16_t admitPoll(const EmbAJAXClientSession *session);
+    uint64_t _latest_ping = 0;
 };
 
 /** @brief The main interface class
@@ -733,15 +1769,15 @@ public:
  *  print() (for page loads) adn handleRequest() (for AJAX calls) to be called on requests. By default,
  *  both page loads, and AJAX are handled on the same URL, but the first via GET, and the second
  *  via POST. */
-template<size_t NUM> class EmbAJAXPage : public EmbAJAXContainer<NUM>, public EmbAJAXPageBase {
+template<size_t NUM> class EmbAJAXPage : public EmbAJAXContainerBase, public EmbAJAXPageBase {
 public:
     /** Create a web page.
      *  @param children list of elements on the page
      *  @param title title (may be 0). This string is not copied, please do not use a temporary string.
      *  @param header_add literal text (may be 0) to be added to the header, e.g. CSS (linked or in-line). This string is not copied, please do not use a temporary string). 
      *  @param min_interval minimum interval (ms) between two requests sent by a single client. A lower value may reduce latency at the cost of traffic/CPU. */
-    EmbAJAXPage(EmbAJAXBase* children[NUM], const char* title, const char* header_add = 0, uint16_t min_interval=100) : EmbAJAXContainer<NUM>(children),
-        _title(title ? title : EmbAJAXBase::null_string), _header_add(header_add ? header_add : EmbAJAXBase::null_string), _min_interval(min_interval) {}
+    constexpr EmbAJAXPage(EmbAJAXBase* children[NUM], const char* title, const char* header_add = 0, uint16_t min_interval=100) : EmbAJAXContainerBase(children, NUM),
+        EmbAJAXPageBase(title, header_add, min_interval) {}
     /** Duplication of print(), needed for internal reasons. Use print(), instead! */
     void printPage() override {
         print();
@@ -749,7 +1785,7 @@ public:
     /** Serve the page including headers and all child elements. You should arrange for this function to be called, whenever
      *  there is a GET request to the desired URL. */
     void print() const override {
-        EmbAJAXBase::printPage(EmbAJAXContainer<NUM>::_children, NUM, _title, _header_add, _min_interval);
+        EmbAJAXBase::printPage(_children, NUM, _title, _header_add, _min_interval);
     }
     /** Handle AJAX client request. You should arrange for this function to be called, whenever there is a POST request
      *  to whichever URL you served the page itself, from.
@@ -760,21 +1796,52 @@ public:
      *                         This way, an update can be sent back to the client, immediately, for a smooth UI experience.
      *                         (Otherwise the client will be updated on the next poll). */
     void handleRequest(void (*change_callback)()=0) override {
-        _latest_ping = millis();
-        EmbAJAXBase::handleRequest(EmbAJAXContainer<NUM>::_children, NUM, change_callback);
+        EmbAJAXBase::handleRequest(change_callback, this);
     }
-    /** Returns true if a client seems to be connected (connected clients should send a ping at least once per second; by default this
-     *  function returns whether a ping has been seen within the last 5000 ms.
-     *  @param latency_ms Number of milliseconds to consider as maximum silence period for an active connection */
-    bool hasActiveClient(uint64_t latency_ms=5000) const {
-        return(_latest_ping && (_latest_ping + latency_ms > millis()));
+};
+
+#if EMBAJAX_METRICS
+/** @brief Endpoint for runtime metrics
+ *
+ *  Serves the counters from EmbAJAXBase::metrics() as JSON, or in the text format used by Prometheus. Install this next to your page(s),
+ *  and query it with a plain GET request:
+ *  @code
+ *  EmbAJAXMetricsPage metrics(EmbAJAXMetricsPage::Prometheus);
+ *  [...]
+ *  driver.installPage(&metrics, "/metrics");
+ *  @endcode */
+class EmbAJAXMetricsPage : public EmbAJAXPageBase {
+public:
+    enum Format {
+        JSON,       ///< A single JSON object. Histograms are given as arrays of counts per bucket, along with the bucket limits
+        Prometheus  ///< Prometheus text exposition format
+    };
+    constexpr EmbAJAXMetricsPage(Format format=JSON) : EmbAJAXPageBase(0, 0, 0), _format(format) {}
+    void printPage() override;
+    void handleRequest(void (*change_callback)()=0) override {
+        UNUSED(change_callback);
+        printPage();
     }
-protected:
-    const char* _title;
-    const char* _header_add;
-    uint16_t _min_interval;
-    uint64_t _latest_ping = 0;
+private:
+    Format _format;
 };
+#endif
+
+#if EMBAJAX_TRACE > 0
+/** @brief Endpoint for trace spans
+ *
+ *  Serves the spans recorded by EmbAJAXTrace in Chrome trace event format. Install this next to your page(s), like EmbAJAXMetricsPage, and
+ *  save the result of a GET request to a file. */
+class EmbAJAXTracePage : public EmbAJAXPageBase {
+public:
+    constexpr EmbAJAXTracePage() : EmbAJAXPageBase(0, 0, 0) {}
+    void printPage() override;
+    void handleRequest(void (*change_callback)()=0) override {
+        UNUSED(change_callback);
+        printPage();
+    }
+};
+#endif
 
 // If the user has not #includ'ed a specific output driver implementation, make a good guess, here
 #if not defined (EMBAJAX_OUTUPUTDRIVER_IMPLEMENTATION)
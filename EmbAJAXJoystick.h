@@ -24,18 +24,18 @@
 
 #include "EmbAJAX.h"
 
-const char EmbAJAXJoystick_SNAP_BACK[] = "if (!pressed) { x = 0; y = 0; }\n";
+const char EmbAJAXJoystick_SNAP_BACK[] = "if (!pressed) { x = 0; y = 0; }" EMBAJAX_NL;
 const char EmbAJAXJoystick_NO_SNAP_BACK[] = "";
 const char EmbAJAXJoystick_FREE_POSITION[] = "";
-const char EmbAJAXJoystick_POSITION_9_DIRECTIONS[] = "if (pressed) {\n"
-                                                      "  if (x < -500) x = -1000;\n"
-                                                      "  else if (x > 500) x = 1000\n"
-                                                      "  else x = 0;\n"
-                                                      "\n"
-                                                      "  if (y < -500) y = -1000;\n"
-                                                      "  else if (y > 500) y = 1000\n"
-                                                      "  else y = 0;\n"
-                                                      "}\n";
+const char EmbAJAXJoystick_POSITION_9_DIRECTIONS[] = "if (pressed) {" EMBAJAX_NL
+                                                          "if (x < -500) x = -1000;" EMBAJAX_NL
+                                                          "else if (x > 500) x = 1000;" EMBAJAX_NL
+                                                          "else x = 0;" EMBAJAX_NL
+                                                          EMBAJAX_NL
+                                                          "if (y < -500) y = -1000;" EMBAJAX_NL
+                                                          "else if (y > 500) y = 1000;" EMBAJAX_NL
+                                                          "else y = 0;" EMBAJAX_NL
+                                                      "}" EMBAJAX_NL;
 
 /** This class provides a basic joystick for directional control. WORK IN PROGRESS, API and behavior may be subject to change in future versions of EmbAJAX. */
 class EmbAJAXJoystick : public EmbAJAXElement {
@@ -46,6 +46,11 @@ public:
      * @param position_adjust: Custom javascript that will be applied to "correct" the user supplied position, e.g. snapping it to certain allowed positions. @See e.g. EmbAJAXJoystick_POSITION_9_DIRECTIONS
      * @param snap_back: Custom javascript that will be applied to snap back the position on mouse release. @See EmbAJAXJoystick_SNAP_BACK */
     EmbAJAXJoystick(const char* id, int width, int height, const char* position_adjust=EmbAJAXJoystick_FREE_POSITION, const char* snap_back=EmbAJAXJoystick_SNAP_BACK) : EmbAJAXElement(id) {
+        _throttle = 0;
+        _change_callback = 0;
+        _curx = _cury = 0;
+        _pressed = false;
+        updateValueString();
         _width = width;
         _height = height;
         _position_adjust = position_adjust;
@@ -54,78 +59,82 @@ public:
     void print() const override {
         EmbAJAXBase::_driver->printFormatted("<canvas id=", HTML_QUOTED_STRING(_id), " width=", INTEGER_VALUE(_width), " height=", INTEGER_VALUE(_height),
                                              " style=\"cursor: all-scroll\"></canvas>"   // style="border-radius:50%; background-color:grey; cursor: all-scroll"
-                                            "<script>\n"
-                                            "var elem = document.getElementById(", JS_QUOTED_STRING(_id), ");\n");
+                                            "<script>" EMBAJAX_NL
+                                            "var elem = document.getElementById(", JS_QUOTED_STRING(_id), ");" EMBAJAX_NL);
+        // NOTE: The custom snippets are followed by a hard line break, as they are not under our control (may end in a comment, or without a semicolon).
         EmbAJAXBase::_driver->printFormatted(
-           "elem.__defineSetter__('coords', function(value) {\n"
-           "  var vals = value.split(',');\n"
-           "  this.update(vals[0], vals[1], false);\n"
-           "});\n"
-           "\n"
-           "elem.updateFromClient = function(x, y, nomerge=false) {\n"
-           "  var width = this.width;\n"
-           "  var height = this.height;\n"
-           "  var pressed = this.pressed;\n"
-           "  x = Math.round(((x - width / 2) * 2000) / (width-40));\n"    // Scale values to +/-1000, independent of display size
-           "  y = Math.round(((y - height / 2) * 2000) / (height-40));\n",
-           PLAIN_STRING(_snap_back), "",  // NOTE: inserted "", because printFormatted macro assumed static string between each arg
+           "elem.__defineSetter__('coords', function(value) {" EMBAJAX_NL
+               "var vals = value.split(',');" EMBAJAX_NL
+               "this.update(vals[0], vals[1], false);" EMBAJAX_NL
+           "});" EMBAJAX_NL
+           EMBAJAX_NL
+           "elem.updateFromClient = function(x, y, nomerge=false) {" EMBAJAX_NL
+               "var width = this.width;" EMBAJAX_NL
+               "var height = this.height;" EMBAJAX_NL
+               "var pressed = this.pressed;" EMBAJAX_NL
+               "x = Math.round(((x - width / 2) * 2000) / (width-40));" EMBAJAX_NL    // Scale values to +/-1000, independent of display size
+               "y = Math.round(((y - height / 2) * 2000) / (height-40));" EMBAJAX_NL,
+           PLAIN_STRING(_snap_back), "\n",  // NOTE: printFormatted macro assumes static string between each arg, anyway
            PLAIN_STRING(_position_adjust),
-           "  this.update(x, y, true, nomerge);\n"
-           "}\n"
-           "\n"
-           "elem.update = function(x, y, send=true, nomerge=false) {\n"
-           "  var oldx = this.posx;\n"
-           "  var oldy = this.posy;\n"
-           "  this.posx = x;\n"
-           "  this.posy = y;\n"
-           "  if (this.posx != oldx || this.posy != oldy) {\n"
-           "    var ctx = this.getContext('2d');\n"
-           "    ctx.clearRect(0, 0, this.width, this.height);\n"
-           "    this.drawKnob(ctx, this.posx, this.posy);\n"
-           "    if(send) doRequest(this.id,this.pressed + ',' + this.posx + ',' + this.posy, nomerge ? 2 : 1);\n"
-           "  }\n"
-           "}\n"
-           "\n"
+               "\n"
+               "this.update(x, y, true, nomerge);" EMBAJAX_NL
+           "};" EMBAJAX_NL
+           EMBAJAX_NL
+           "elem.update = function(x, y, send=true, nomerge=false) {" EMBAJAX_NL
+               "var oldx = this.posx;" EMBAJAX_NL
+               "var oldy = this.posy;" EMBAJAX_NL
+               "this.posx = x;" EMBAJAX_NL
+               "this.posy = y;" EMBAJAX_NL
+               "if (this.posx != oldx || this.posy != oldy) {" EMBAJAX_NL
+                   "var ctx = this.getContext('2d');" EMBAJAX_NL
+                   "ctx.clearRect(0, 0, this.width, this.height);" EMBAJAX_NL
+                   "this.drawKnob(ctx, this.posx, this.posy);" EMBAJAX_NL
+                   "if(send) doRequest(this.id,this.pressed + ',' + this.posx + ',' + this.posy, nomerge ? 2 : 1);" EMBAJAX_NL
+               "}" EMBAJAX_NL
+           "};" EMBAJAX_NL
+           EMBAJAX_NL
            // TODO: This should be customizable
-           "elem.drawKnob = function(ctx, x, y) {\n"
-           "  var width = this.width;\n"
-           "  var height = this.height;\n"
-           "  x = x * (width-40) / 2000 + width / 2;\n"
-           "  y = y * (height-40) / 2000 + height / 2;\n"
-           "  ctx.beginPath();\n"
-           "  ctx.arc(x, y, 15, 0, 2 * Math.PI);\n"
-           "  ctx.stroke();\n"
-           "  ctx.fill();\n"
-           "}\n"
-           "\n"
-           "elem.press = function(x, y) {\n"
-           "  this.pressed = 1;\n"
-           "  this.updateFromClient(x, y, true);\n"
-           "}\n"
-           "\n"
-           "elem.move = function(x, y) {\n"
-           "  this.updateFromClient(x, y);\n"
-           "}\n"
-           "\n"
-           "elem.release = function(x, y) {\n"
-           "  this.pressed = 0;\n"
-           "  this.updateFromClient(x, y, true);\n"
-           "}\n"
-           "\n"
-           "elem.addEventListener('mousedown', function(event) { this.press(event.offsetX, event.offsetY); }.bind(elem), false);\n"
-           "elem.addEventListener('mousemove', function(event) { this.move(event.offsetX, event.offsetY); }.bind(elem), false);\n"
-           "elem.addEventListener('mouseup', function(event) { this.release(event.offsetX, event.offsetY); }.bind(elem), false);\n"
-           "elem.addEventListener('mouseleave', function(event) { this.release(event.offsetX, event.offsetY); }.bind(elem), false);\n"
-           "elem.addEventListener('touchstart', function(event) { this.press(event.touches[0].offsetX, event.touches[0].offsetY); }.bind(elem), false);\n"
-           "elem.addEventListener('touchmove', function(event) { this.move(event.touches[0].offsetX, event.touches[0].offsetY); }.bind(elem), false);\n"
-           "elem.addEventListener('touchend', function(event) { this.release(event.touches[0].offsetX, event.touches[0].offsetY); }.bind(elem), false);\n"
-           "</script>\n");
+           "elem.drawKnob = function(ctx, x, y) {" EMBAJAX_NL
+               "var width = this.width;" EMBAJAX_NL
+               "var height = this.height;" EMBAJAX_NL
+               "x = x * (width-40) / 2000 + width / 2;" EMBAJAX_NL
+               "y = y * (height-40) / 2000 + height / 2;" EMBAJAX_NL
+               "ctx.beginPath();" EMBAJAX_NL
+               "ctx.arc(x, y, 15, 0, 2 * Math.PI);" EMBAJAX_NL
+               "ctx.stroke();" EMBAJAX_NL
+               "ctx.fill();" EMBAJAX_NL
+           "};" EMBAJAX_NL
+           EMBAJAX_NL
+           "elem.press = function(x, y) {" EMBAJAX_NL
+               "this.pressed = 1;" EMBAJAX_NL
+               "this.updateFromClient(x, y, true);" EMBAJAX_NL
+           "};" EMBAJAX_NL
+           EMBAJAX_NL
+           "elem.move = function(x, y) {" EMBAJAX_NL
+               "this.updateFromClient(x, y);" EMBAJAX_NL
+           "};" EMBAJAX_NL
+           EMBAJAX_NL
+           "elem.release = function(x, y) {" EMBAJAX_NL
+               "this.pressed = 0;" EMBAJAX_NL
+               "this.updateFromClient(x, y, true);" EMBAJAX_NL
+           "};" EMBAJAX_NL
+           EMBAJAX_NL
+           "elem.addEventListener('mousedown', function(event) { this.press(event.offsetX, event.offsetY); }.bind(elem), false);" EMBAJAX_NL
+           "elem.addEventListener('mousemove', function(event) { this.move(event.offsetX, event.offsetY); }.bind(elem), false);" EMBAJAX_NL
+           "elem.addEventListener('mouseup', function(event) { this.release(event.offsetX, event.offsetY); }.bind(elem), false);" EMBAJAX_NL
+           "elem.addEventListener('mouseleave', function(event) { this.release(event.offsetX, event.offsetY); }.bind(elem), false);" EMBAJAX_NL
+           "elem.addEventListener('touchstart', function(event) { this.press(event.touches[0].offsetX, event.touches[0].offsetY); }.bind(elem), false);" EMBAJAX_NL
+           "elem.addEventListener('touchmove', function(event) { this.move(event.touches[0].offsetX, event.touches[0].offsetY); }.bind(elem), false);" EMBAJAX_NL
+           "elem.addEventListener('touchend', function(event) { this.release(event.touches[0].offsetX, event.touches[0].offsetY); }.bind(elem), false);" EMBAJAX_NL
+           "</script>" EMBAJAX_NL);
     }
     void updateFromDriverArg(const char* argname) {
         const int bufsize = 16;
         char buf[bufsize];
         _driver->getArg(argname, buf, bufsize);
         // format: "P,X,Y", each a number. Parsing from reverse
+        const int old_x = _curx;
+        const int old_y = _cury;
         int p = bufsize;
         while (--p >= 0) if (buf[p] == '\0') break;
         while (--p >= 0) if (buf[p] == ',') break;
@@ -136,6 +145,8 @@ public:
         buf[p] = '\0';
         _pressed = atoi(buf);
         updateValueString();
+        if (_throttle) _throttle->sync(_curx, _cury);
+        if (_change_callback && (_curx != old_x || _cury != old_y)) _change_callback(this, old_x, old_y, _curx, _cury);
     }
     /** Get current x position. Position is returned as a value between -1000 and +1000 (center 0), independent of the size of the control. */
     int getX() const { return _curx; };
@@ -146,10 +157,18 @@ public:
         if (x != _curx || y != _cury) {
             _curx = x;
             _cury = y;
-            setChanged();
+            if (!_throttle || _throttle->accept(x, y)) setChanged();
             updateValueString();
         }
     }
+    /** Limit the updates caused by setPosition(). See EmbAJAXThrottle. The deadband applies to each axis. @param throttle may be 0 to remove the throttle */
+    void setThrottle(EmbAJAXThrottle *throttle) {
+        _throttle = throttle;
+    }
+    /** Set a function to be called, when the joystick was moved in a client, with the previous, and the new position. @param callback may be 0 to remove the callback */
+    void setChangeCallback(void (*callback)(EmbAJAXJoystick*, int old_x, int old_y, int new_x, int new_y)) {
+        _change_callback = callback;
+    }
     const char* valueProperty(uint8_t which = EmbAJAXBase::Value) const override {
         if (which == EmbAJAXBase::Value) return "coords";
         return EmbAJAXElement::valueProperty(which);
@@ -158,6 +177,13 @@ public:
         if (which == EmbAJAXBase::Value) return _value;
         return EmbAJAXElement::value(which);
     }
+    static constexpr size_t maxUpdateSize() {
+        return updateSizeBound(sizeof("coords"), sizeof("-1000,-1000") - 1, false);
+    }
+protected:
+    void refreshValue() override {
+        if (_throttle && _throttle->due()) setChanged();
+    }
 private:
     void updateValueString() {
         itoa(_curx, _value, 10);
@@ -173,6 +199,8 @@ private:
     const char* _position_adjust;
     int _curx, _cury;
     bool _pressed;
+    EmbAJAXThrottle *_throttle;
+    void (*_change_callback)(EmbAJAXJoystick*, int, int, int, int);
 };
 
 #endif
@@ -45,37 +45,74 @@ public:
         EmbAJAXBase::setDriver(this);
         _server = server;
         _request = 0;
+        _bodylen = 0;
+        _buffer_size = 1460;
+    }
+    /** Set the initial buffer size for update responses (default: 1460). If you know an upper bound of the response size (see
+     *  EmbAJAXTypedPage::maxResponseSize()), setting this avoids reallocations while the response is being written:
+     *  @code
+     *  driver.setResponseBufferSize(decltype(page)::maxResponseSize());
+     *  @endcode */
+    void setResponseBufferSize(size_t size) {
+        _buffer_size = size;
     }
     void printHeader(bool html) override {
-        _response = _request->beginResponseStream(html ? "text/html" : "text/json");
+        if (html) _response = _request->beginResponseStream("text/html");
+        else _response = _request->beginResponseStream("text/json", _buffer_size);
     }
-    void printContent(const char *content) override {
-        _response->print(content);
+    void printTypedHeader(const char* content_type) override {
+        _response = _request->beginResponseStream(content_type);
     }
     const char* getArg(const char* name, char* buf, int buflen) override {
-        _request->arg(name).toCharArray (buf, buflen);
+        if (getParsedArg(name, buf, buflen)) return buf;
+        _request->arg(name).toCharArray (buf, buflen);  // Fallback for form encoded requests
         return buf;
     }
     void installPage(EmbAJAXPageBase *page, const char *path, void (*change_callback)()=0) override {
-        _server->on(path, [=](AsyncWebServerRequest* request) {
+        _server->on(path, HTTP_ANY, [=](AsyncWebServerRequest* request) {
              _request = request;
              _response = 0;
              if (_request->method() == HTTP_POST) {  // AJAX request
+                 _body[_bodylen] = '\0';
+                 parseRequestBody(_bodylen ? _body : 0);
                  page->handleRequest(change_callback);
+                 parseRequestBody(0);
+                 _bodylen = 0;
              } else {  // Page load
                  page->printPage();
              }
              _request->send(_response);
              _request = 0;
+        }, nullptr, [=](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+             // Collect the raw request body into a fixed buffer. NOTE: Requests are tiny, and the final chunk is always followed by the
+             // request handler, above, so there is no need to keep track of several requests.
+             UNUSED(request);
+             UNUSED(total);
+             if (index == 0) _bodylen = 0;
+             size_t n = min(len, (size_t) (EMBAJAX_MAX_REQUEST_LEN - 1 - _bodylen));
+             memcpy(&_body[_bodylen], data, n);
+             _bodylen += n;
         });
     }
     void loopHook() override {};
+protected:
+    void writeContent(const char *content) override {
+        EMBAJAX_MEMORY_SAMPLE();
+        _response->print(content);
+    }
 private:
     EmbAJAXOutputDriverWebServerClass *_server;
     AsyncWebServerRequest *_request;
     AsyncResponseStream *_response;
+    char _body[EMBAJAX_MAX_REQUEST_LEN];
+    size_t _bodylen;
+    size_t _buffer_size;
 };
 
+#if EMBAJAX_COMPRESSION_WINDOW > 0
+typedef EmbAJAXCompressedOutput<EmbAJAXOutputDriverESPAsync> EmbAJAXOutputDriver;
+#else
 typedef EmbAJAXOutputDriverESPAsync EmbAJAXOutputDriver;
+#endif
 
 #endif
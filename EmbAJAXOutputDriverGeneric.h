@@ -51,17 +51,24 @@ public:
             _server->send(200, "text/json", "");
         }
     }
-    void printContent(const char *content) override {
-        if (content[0] != '\0') _server->sendContent(content);  // NOTE: There seems to be a bug in the ESP8266 server when sending empty string.
+    void printTypedHeader(const char* content_type) override {
+        _server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+        _server->send(200, content_type, "");
     }
     const char* getArg(const char* name, char* buf, int buflen) override {
-        _server->arg(name).toCharArray (buf, buflen);
+        if (getParsedArg(name, buf, buflen)) return buf;
+        _server->arg(name).toCharArray (buf, buflen);  // Fallback for form encoded requests
         return buf;
     }
     void installPage(EmbAJAXPageBase *page, const char *path, void (*change_callback)()=0) override {
         _server->on(path, [=]() {
              if (_server->method() == HTTP_POST) {  // AJAX request
+                 // The server keeps the body of non-form requests in the "plain" argument. Fetch that once, and parse it in place.
+                 // Assigning to the same String, each time, allows its buffer to be re-used.
+                 _body = _server->arg("plain");
+                 parseRequestBody(_body.length() ? _body.begin() : 0);
                  page->handleRequest(change_callback);
+                 parseRequestBody(0);
              } else {  // Page load
                  page->printPage();
              }
@@ -70,10 +77,20 @@ public:
     void loopHook() override {
         _server->handleClient();
     };
+protected:
+    void writeContent(const char *content) override {
+        EMBAJAX_MEMORY_SAMPLE();
+        if (content[0] != '\0') _server->sendContent(content);  // NOTE: There seems to be a bug in the ESP8266 server when sending empty string.
+    }
 private:
     EmbAJAXOutputDriverWebServerClass *_server;
+    String _body;
 };
 
+#if EMBAJAX_COMPRESSION_WINDOW > 0
+typedef EmbAJAXCompressedOutput<EmbAJAXOutputDriverGeneric> EmbAJAXOutputDriver;
+#else
 typedef EmbAJAXOutputDriverGeneric EmbAJAXOutputDriver;
+#endif
 
 #endif
@@ -0,0 +1,327 @@
+/*
+ *
+ * EmbAJAX - Simplistic framework for creating and handling displays and controls on a WebPage served by an Arduino (or other small device).
+ *
+ * Copyright (C) 2018-2023 Thomas Friedrichsmeier
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef EMBAJAXOUTPUTDRIVERRAWSOCKET_H
+#define EMBAJAXOUTPUTDRIVERRAWSOCKET_H
+
+#if defined (EMBAJAX_OUTUPUTDRIVER_IMPLEMENTATION)
+#error Duplicate definition of output driver. Fix your include-directives.
+#endif
+#define EMBAJAX_OUTUPUTDRIVER_IMPLEMENTATION
+
+#if not defined EmbAJAXOutputDriverWebServerClass
+#error Please define EmbAJAXOutputDriverWebServerClass (e.g. WiFiServer, or EthernetServer)
+#endif
+
+// For EmbAJAXPage. Important to include after defining EMBAJAX_OUTUPUTDRIVER_IMPLEMENTATION
+#include "EmbAJAX.h"
+
+/** Maximum number of pages that can be installed on EmbAJAXOutputDriverRawSocket */
+#if !defined EMBAJAX_MAX_PAGES
+#define EMBAJAX_MAX_PAGES 4
+#endif
+
+/** Size of the output buffer of EmbAJAXOutputDriverRawSocket. Small pieces of the response are collected, until this size is reached. */
+#if !defined EMBAJAX_RAWSOCKET_BUFFER
+#define EMBAJAX_RAWSOCKET_BUFFER 128
+#endif
+
+/** Number of milliseconds to wait for the remainder of an incomplete request, in EmbAJAXOutputDriverRawSocket. The driver never
+ *  blocks while waiting, but the connection is closed, if the request has not been completed within this time. */
+#if !defined EMBAJAX_REQUEST_TIMEOUT
+#define EMBAJAX_REQUEST_TIMEOUT 1000
+#endif
+
+/** Number of milliseconds after which an idle persistent connection is closed by EmbAJAXOutputDriverRawSocket */
+#if !defined EMBAJAX_KEEPALIVE_TIMEOUT
+#define EMBAJAX_KEEPALIVE_TIMEOUT 5000
+#endif
+
+/** @brief Parse state of a single connection of EmbAJAXOutputDriverRawSocket
+ *
+ *  Requests may arrive in several pieces. Whatever is available is parsed right away, and the state is kept until the next piece
+ *  arrives. Each connection needs its own buffer of EMBAJAX_MAX_REQUEST_LEN bytes for this. */
+struct EmbAJAXRawSocketConnection {
+    EmbAJAXRawSocketConnection() {
+        reset();
+    }
+    void reset() {
+        stage = RequestLine;
+        pos = 0;
+        content_length = 0;
+    }
+    /** @returns true, if a request has been started, but not yet completed */
+    bool busy() const {
+        return (stage != RequestLine || pos > 0);
+    }
+    enum Stage : uint8_t {
+        RequestLine,
+        Headers,
+        Body
+    } stage;
+    bool post;
+    bool keep_alive;
+    int8_t pagenum;
+    size_t content_length;
+    size_t pos;
+    uint32_t started;
+    char buf[EMBAJAX_MAX_REQUEST_LEN];
+};
+
+/** @brief Abstract base class for EmbAJAXOutputDriverRawSocket
+ *
+ *  Implements the (very few) parts of HTTP/1.1 needed by EmbAJAX on top of any Arduino Client: GET for the page, POST for the AJAX
+ *  requests, persistent connections (with chunked responses), and pipelined requests. Not depending on the type of server, this can
+ *  also be used with a custom (e.g. socket backed) Client implementation. */
+class EmbAJAXOutputDriverRawSocketBase : public EmbAJAXOutputDriverBase {
+public:
+    void printHeader(bool html) override {
+        _client->print(F("HTTP/1.1 200 OK\r\nCache-Control: no-store\r\nContent-Type: "));
+        _client->print(html ? F("text/html\r\n") : F("text/json\r\n"));
+        _client->print(_chunked ? F("Transfer-Encoding: chunked\r\nConnection: keep-alive\r\n\r\n") : F("Connection: close\r\n\r\n"));
+    }
+    void printTypedHeader(const char* content_type) override {
+        _client->print(F("HTTP/1.1 200 OK\r\nCache-Control: no-store\r\nContent-Type: "));
+        _client->print(content_type);
+        _client->print(_chunked ? F("\r\nTransfer-Encoding: chunked\r\nConnection: keep-alive\r\n\r\n") : F("\r\nConnection: close\r\n\r\n"));
+    }
+    void finishContent() override {
+        flushOutput();
+    }
+    const char* getArg(const char* name, char* buf, int buflen) override {
+        if (getParsedArg(name, buf, buflen)) return buf;
+        buf[0] = '\0';
+        return buf;
+    }
+    void installPage(EmbAJAXPageBase *page, const char *path, void (*change_callback)()=0) override {
+        if (_numpages >= EMBAJAX_MAX_PAGES) return;
+        _pages[_numpages].path = path;
+        _pages[_numpages].page = page;
+        _pages[_numpages].change_callback = change_callback;
+        ++_numpages;
+    }
+    /** Parse whatever is currently available on the given connection, and serve any requests completed by that (there may be
+     *  several, if the client pipelines them). This never waits for further data to arrive.
+     *  @param state parse state of this connection. Keep this around between calls, for as long as the connection is open.
+     *  @returns false, if the connection should be closed */
+    bool handleClient(Client &client, EmbAJAXRawSocketConnection &state) {
+        _client = &client;
+        bool keep_alive = true;
+        while (keep_alive && client.available()) {
+            int c = client.read();
+            if (c < 0) break;
+            if (!state.busy()) state.started = millis();
+            if (parseChar(state, c)) {
+                keep_alive = serveRequest(state);
+                state.reset();
+            }
+        }
+        _client = 0;
+        return keep_alive;
+    }
+protected:
+    void writeContent(const char *content) override {
+        EMBAJAX_MEMORY_SAMPLE();
+        size_t len = strlen(content);
+        if (_outlen + len > EMBAJAX_RAWSOCKET_BUFFER) {
+            flushOutput();
+            if (len > EMBAJAX_RAWSOCKET_BUFFER) {
+                writeChunk(content, len);
+                return;
+            }
+        }
+        memcpy(&_outbuf[_outlen], content, len);
+        _outlen += len;
+    }
+    EmbAJAXOutputDriverRawSocketBase() {
+        EmbAJAXBase::setDriver(this);
+        _client = 0;
+        _numpages = 0;
+        _chunked = false;
+        _outlen = 0;
+    }
+private:
+    /** Send a piece of the response (as a chunk, if using chunked encoding) */
+    void writeChunk(const char *content, size_t len) {
+        if (!len) return;  // NOTE: An empty chunk would end the response
+        if (_chunked) {
+            char buf[12];
+            snprintf(buf, sizeof(buf), "%x\r\n", (unsigned int) len);
+            _client->print(buf);
+        }
+        _client->write((const uint8_t*) content, len);
+        if (_chunked) _client->print(F("\r\n"));
+    }
+    void flushOutput() {
+        writeChunk(_outbuf, _outlen);
+        _outlen = 0;
+    }
+    /** Feed a single character of the request into the parse state. Overlong lines, and bodies are truncated.
+     *  @returns true, once the request is complete */
+    bool parseChar(EmbAJAXRawSocketConnection &state, char c) {
+        if (state.stage == EmbAJAXRawSocketConnection::Body) {
+            if (state.pos < EMBAJAX_MAX_REQUEST_LEN - 1) state.buf[state.pos++] = c;
+            return (--state.content_length == 0);
+        }
+        if (c == '\r') return false;
+        if (c != '\n') {
+            if (state.pos < EMBAJAX_MAX_REQUEST_LEN - 1) state.buf[state.pos++] = c;
+            return false;
+        }
+        state.buf[state.pos] = '\0';
+        state.pos = 0;
+        if (state.stage == EmbAJAXRawSocketConnection::RequestLine) {
+            parseRequestLine(state);
+            state.stage = EmbAJAXRawSocketConnection::Headers;
+            return false;
+        }
+        // Headers: Only Content-Length, and Connection are of interest
+        if (state.buf[0] != '\0') {
+            if (strncasecmp(state.buf, "Content-Length:", 15) == 0) {
+                state.content_length = atol(&state.buf[15]);
+            } else if (strncasecmp(state.buf, "Connection:", 11) == 0) {
+                if (strstr(&state.buf[11], "close")) state.keep_alive = false;
+            }
+            return false;
+        }
+        // End of headers. Body follows, if any.
+        state.stage = EmbAJAXRawSocketConnection::Body;
+        return (state.content_length == 0);
+    }
+    /** Request line: METHOD PATH VERSION */
+    void parseRequestLine(EmbAJAXRawSocketConnection &state) {
+        state.post = (strncmp(state.buf, "POST ", 5) == 0);
+        state.pagenum = -1;
+        state.keep_alive = false;
+        char *path = strchr(state.buf, ' ');
+        if (!path) return;
+        ++path;
+        size_t pathlen = strcspn(path, " ?");
+        state.keep_alive = (strstr(path + pathlen, "HTTP/1.1") != 0);
+        for (uint8_t i = 0; i < _numpages; ++i) {
+            if (strlen(_pages[i].path) == pathlen && strncmp(_pages[i].path, path, pathlen) == 0) {
+                state.pagenum = i;
+                break;
+            }
+        }
+    }
+    /** Answer a request, once it has been read completely. @returns false, if the connection should be closed */
+    bool serveRequest(EmbAJAXRawSocketConnection &state) {
+        state.buf[state.pos] = '\0';  // body, if any
+        bool keep_alive = state.keep_alive;
+        if (state.pagenum < 0) {
+            _client->print(keep_alive ? F("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n") : F("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"));
+            return keep_alive;
+        }
+        _chunked = keep_alive;
+        if (state.post) {  // AJAX request
+            parseRequestBody(state.buf);
+            _pages[state.pagenum].page->handleRequest(_pages[state.pagenum].change_callback);
+            parseRequestBody(0);
+        } else {  // Page load
+            _pages[state.pagenum].page->printPage();
+        }
+        if (_chunked) _client->print(F("0\r\n\r\n"));
+        return keep_alive;
+    }
+
+    Client *_client;
+    struct {
+        const char* path;
+        EmbAJAXPageBase* page;
+        void (*change_callback)();
+    } _pages[EMBAJAX_MAX_PAGES];
+    uint8_t _numpages;
+    bool _chunked;
+    char _outbuf[EMBAJAX_RAWSOCKET_BUFFER];
+    size_t _outlen;
+};
+
+/** @brief Output driver implementation working directly on top of a TCP server, such as WiFiServer, or EthernetServer
+ *
+ *  This driver does not need any web server library. It implements the few HTTP features needed by EmbAJAX, itself, and keeps
+ *  connections open for subsequent requests, avoiding the connection setup for each poll.
+ *
+ *  To use this, define EmbAJAXOutputDriverWebServerClass to the class of your server, and include EmbAJAXOutputDriverRawSocket.h
+ *  @em before EmbAJAX.h:
+ *  @code
+ *  #include <Ethernet.h>
+ *  #define EmbAJAXOutputDriverWebServerClass EthernetServer
+ *  #include <EmbAJAXOutputDriverRawSocket.h>
+ *  #include <EmbAJAX.h>
+ *  @endcode
+ *
+ *  The server class needs to provide an accept() function returning new connections (one at a time).
+ *
+ *  @param SERVER class of the server
+ *  @param MAXCONN maximum number of connections to keep open. If a further connection comes in, the least recently used one is closed.
+ *                 Each connection takes EMBAJAX_MAX_REQUEST_LEN bytes of RAM for its parse state. */
+template<class SERVER, size_t MAXCONN=2> class EmbAJAXOutputDriverRawSocket : public EmbAJAXOutputDriverRawSocketBase {
+public:
+    /** To register a server with EmbAJAX, simply create a (global) instance of this class.
+     *  @param server pointer to the server. You will still have to call begin() on the server, yourself. */
+    EmbAJAXOutputDriverRawSocket(SERVER *server) : EmbAJAXOutputDriverRawSocketBase() {
+        _server = server;
+    }
+    void loopHook() override {
+        ClientType client = _server->accept();
+        if (client) {
+            size_t slot = 0;
+            for (size_t i = 0; i < MAXCONN; ++i) {
+                if (!_clients[i]) {
+                    slot = i;
+                    break;
+                }
+                if (_last_active[i] < _last_active[slot]) slot = i;
+            }
+            if (_clients[slot]) _clients[slot].stop();
+            _clients[slot] = client;
+            _connections[slot].reset();
+            _last_active[slot] = millis();
+        }
+        for (size_t i = 0; i < MAXCONN; ++i) {
+            if (!_clients[i]) continue;
+            if (_clients[i].available()) {
+                _last_active[i] = millis();
+                if (!handleClient(_clients[i], _connections[i])) _clients[i].stop();
+            } else if (!_clients[i].connected() || (millis() - _last_active[i] > EMBAJAX_KEEPALIVE_TIMEOUT)
+                       || (_connections[i].busy() && (millis() - _connections[i].started > EMBAJAX_REQUEST_TIMEOUT))) {
+                _clients[i].stop();
+            }
+        }
+    }
+private:
+    /** Used for type deduction, only (not implemented) */
+    static SERVER& serverType();
+    typedef decltype(serverType().accept()) ClientType;
+    SERVER *_server;
+    ClientType _clients[MAXCONN];
+    uint32_t _last_active[MAXCONN];
+    EmbAJAXRawSocketConnection _connections[MAXCONN];
+};
+
+#if EMBAJAX_COMPRESSION_WINDOW > 0
+typedef EmbAJAXCompressedOutput<EmbAJAXOutputDriverRawSocket<EmbAJAXOutputDriverWebServerClass>> EmbAJAXOutputDriver;
+#else
+typedef EmbAJAXOutputDriverRawSocket<EmbAJAXOutputDriverWebServerClass> EmbAJAXOutputDriver;
+#endif
+
+#endif
@@ -57,22 +57,22 @@ public:
         _rec_buffer_size = rec_buffer_size;
     }
     void print() const override {
-        _driver->printFormatted("<span id=", HTML_QUOTED_STRING(_id), "><script>{\n"
-                              "let spn=document.getElementById(", JS_QUOTED_STRING(_id), ");\n"
-                              "Object.defineProperty(spn, 'EmbAJAXValue', {\n"
-                              "  set: function(value) {\n"
-                              "    if (this.receiveValue) this.receiveValue(value);\n"
-                              "  }\n"
-                              "})\n"
-                              "spn.sendValue = function(value) {\n"
-                              "  doRequest(this.id, value);\n"
-                              "}\n"
-                              "spn.init=function() {\n",
+        _driver->printFormatted("<span id=", HTML_QUOTED_STRING(_id), "><script>{" EMBAJAX_NL
+                              "let spn=document.getElementById(", JS_QUOTED_STRING(_id), ");" EMBAJAX_NL
+                              "Object.defineProperty(spn, 'EmbAJAXValue', {" EMBAJAX_NL
+                                  "set: function(value) {" EMBAJAX_NL
+                                      "if (this.receiveValue) this.receiveValue(value);" EMBAJAX_NL
+                                  "}" EMBAJAX_NL
+                              "});" EMBAJAX_NL
+                              "spn.sendValue = function(value) {" EMBAJAX_NL
+                                  "doRequest(this.id, value);" EMBAJAX_NL
+                              "};" EMBAJAX_NL
+                              "spn.init=function() {\n",  // NOTE: Hard line breaks around the custom script, as it is not under our control
                               PLAIN_STRING(_script),
-                              "\n};\n"
-                              "spn.init();\n"
-                              "spn.EmbAJAXValue=", JS_QUOTED_STRING(_value), ";\n"
-                              "}</script></span>\n");
+                              "\n};" EMBAJAX_NL
+                              "spn.init();" EMBAJAX_NL
+                              "spn.EmbAJAXValue=", JS_QUOTED_STRING(_value), ";" EMBAJAX_NL
+                              "}</script></span>" EMBAJAX_NL);
     }
     const char* value(uint8_t which = EmbAJAXBase::Value) const override {
         if (which == EmbAJAXBase::Value) return _value;
@@ -82,6 +82,10 @@ public:
         if (which == EmbAJAXBase::Value) return "EmbAJAXValue";
         return EmbAJAXElement::valueProperty(which);
     }
+    /** See EmbAJAXBase::maxUpdateSize(). Assumes a value of at most EMBAJAX_ASSUMED_TEXT_LEN characters. */
+    static constexpr size_t maxUpdateSize() {
+        return updateSizeBound(sizeof("EmbAJAXValue"), EMBAJAX_ASSUMED_TEXT_LEN, false);
+    }
     /** Send the given value to the client side script. Note that if you call this very
      *  often, the client will probably not see every value. It will only get to see
      *  the latest value that was set on each poll.
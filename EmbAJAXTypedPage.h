@@ -0,0 +1,324 @@
+/*
+ *
+ * EmbAJAX - Simplistic framework for creating and handling displays and controls on a WebPage served by an Arduino (or other small device).
+ *
+ * Copyright (C) 2018-2023 Thomas Friedrichsmeier
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+*/
+
+#ifndef EMBAJAXTYPEDPAGE_H
+#define EMBAJAXTYPEDPAGE_H
+
+#include "EmbAJAX.h"
+
+/**@file EmbAJAXTypedPage.h
+ *
+ * Pages and containers, whose structure is fully known at compile time. See EmbAJAXTypedPage.
+ */
+
+/** @brief Internal helper for EmbAJAXTypedList
+ *
+ *  Calls into a child of (static) type T. Since T is assumed to be the actual type of the child, calls are
+ *  qualified, i.e. non-virtual, and can be inlined. For the abstract base classes, specializations below fall
+ *  back to virtual calls. */
+template<typename T> struct EmbAJAXTypedCall {
+    static void print(const T* child) {
+        child->T::print();
+    }
+    static bool sendUpdates(T* child, uint16_t since, bool first) {
+        return child->T::sendUpdates(since, first);
+    }
+    static EmbAJAXElement* findChild(const T* child, const char* id) {
+        return child->T::findChild(id);
+    }
+    static EmbAJAXElement* toElement(EmbAJAXElement* child) {
+        return child;
+    }
+    static EmbAJAXElement* toElement(EmbAJAXBase* child) {
+        UNUSED(child);
+        return 0;
+    }
+    static constexpr size_t maxUpdateSize() {
+        return T::maxUpdateSize();
+    }
+    static constexpr size_t footprint() {
+        return EmbAJAXMemory::footprint((const T*) 0);
+    }
+};
+
+template<> struct EmbAJAXTypedCall<EmbAJAXBase> {
+    static void print(const EmbAJAXBase* child) {
+        child->print();
+    }
+    static bool sendUpdates(EmbAJAXBase* child, uint16_t since, bool first) {
+        return child->sendUpdates(since, first);
+    }
+    static EmbAJAXElement* findChild(const EmbAJAXBase* child, const char* id) {
+        return child->findChild(id);
+    }
+    static EmbAJAXElement* toElement(EmbAJAXBase* child) {
+        return child->toElement();
+    }
+    /** Actual class unknown: Assume a plain element (see EmbAJAXElement::maxUpdateSize()) */
+    static constexpr size_t maxUpdateSize() {
+        return EmbAJAXElement::maxUpdateSize();
+    }
+    /** Actual class unknown: Not counted. Such pointers usually point into other objects, e.g. EmbAJAXRadioGroup::button() */
+    static constexpr size_t footprint() {
+        return 0;
+    }
+};
+
+template<> struct EmbAJAXTypedCall<EmbAJAXElement> : public EmbAJAXTypedCall<EmbAJAXBase> {};
+
+/** @brief Compile time list of child elements
+ *
+ *  Internal storage for EmbAJAXTypedPage and EmbAJAXTypedContainer. Children are given as pointers to their
+ *  actual type, or as static strings (const char*). All loops over the children are unrolled at compile time. */
+template<typename... Ts> class EmbAJAXTypedList;
+
+template<> class EmbAJAXTypedList<> {
+public:
+    constexpr EmbAJAXTypedList() {}
+    void print() const {}
+    bool sendUpdates(uint16_t since, bool first) {
+        UNUSED(since);
+        UNUSED(first);
+        return false;
+    }
+    EmbAJAXElement* findChild(const char* id) const {
+        UNUSED(id);
+        return 0;
+    }
+    void setBasicProperty(uint8_t num, bool status) {
+        UNUSED(num);
+        UNUSED(status);
+    }
+    static constexpr size_t maxUpdateSize() {
+        return 0;
+    }
+    static constexpr size_t footprint() {
+        return 0;
+    }
+};
+
+template<typename T, typename... Ts> class EmbAJAXTypedList<T*, Ts...> {
+public:
+    constexpr EmbAJAXTypedList(T* head, Ts... tail) : _head(head), _tail(tail...) {}
+    void print() const {
+        {
+            EMBAJAX_TRACE_SPAN("print", EmbAJAXTypedCall<T>::toElement(_head));
+            EmbAJAXTypedCall<T>::print(_head);
+        }
+        _tail.print();
+    }
+    bool sendUpdates(uint16_t since, bool first) {
+        bool sent = EmbAJAXTypedCall<T>::sendUpdates(_head, since, first);
+        return _tail.sendUpdates(since, first && !sent) || sent;
+    }
+    EmbAJAXElement* findChild(const char* id) const {
+        EmbAJAXElement* child = EmbAJAXTypedCall<T>::toElement(_head);
+        if (child && (strcmp(id, child->id()) == 0)) return child;
+        child = EmbAJAXTypedCall<T>::findChild(_head, id);
+        if (child) return child;
+        return _tail.findChild(id);
+    }
+    void setBasicProperty(uint8_t num, bool status) {
+        static_cast<EmbAJAXBase*>(_head)->setBasicProperty(num, status);
+        _tail.setBasicProperty(num, status);
+    }
+    static constexpr size_t maxUpdateSize() {
+        return EmbAJAXTypedCall<T>::maxUpdateSize() + EmbAJAXTypedList<Ts...>::maxUpdateSize();
+    }
+    static constexpr size_t footprint() {
+        return EmbAJAXTypedCall<T>::footprint() + EmbAJAXTypedList<Ts...>::footprint();
+    }
+private:
+    T* _head;
+    EmbAJAXTypedList<Ts...> _tail;
+};
+
+/** Constant objects in an EmbAJAXTypedList. These can only be printed (e.g. a constexpr EmbAJAXStatic or EmbAJAXConnectionIndicator,
+ *  which can be placed in flash on many MCUs). */
+template<typename T, typename... Ts> class EmbAJAXTypedList<const T*, Ts...> {
+public:
+    constexpr EmbAJAXTypedList(const T* head, Ts... tail) : _head(head), _tail(tail...) {}
+    void print() const {
+        EmbAJAXTypedCall<T>::print(_head);
+        _tail.print();
+    }
+    bool sendUpdates(uint16_t since, bool first) {
+        return _tail.sendUpdates(since, first);
+    }
+    EmbAJAXElement* findChild(const char* id) const {
+        return _tail.findChild(id);
+    }
+    void setBasicProperty(uint8_t num, bool status) {
+        _tail.setBasicProperty(num, status);
+    }
+    static constexpr size_t maxUpdateSize() {
+        return EmbAJAXTypedList<Ts...>::maxUpdateSize();
+    }
+    static constexpr size_t footprint() {
+        return EmbAJAXTypedCall<T>::footprint() + EmbAJAXTypedList<Ts...>::footprint();
+    }
+private:
+    const T* _head;
+    EmbAJAXTypedList<Ts...> _tail;
+};
+
+/** Static HTML in an EmbAJAXTypedList. No EmbAJAXStatic wrapper is needed for this. */
+template<typename... Ts> class EmbAJAXTypedList<const char*, Ts...> {
+public:
+    constexpr EmbAJAXTypedList(const char* head, Ts... tail) : _head(head), _tail(tail...) {}
+    void print() const {
+        EmbAJAXBase::_driver->printContent(_head);
+        _tail.print();
+    }
+    bool sendUpdates(uint16_t since, bool first) {
+        return _tail.sendUpdates(since, first);
+    }
+    EmbAJAXElement* findChild(const char* id) const {
+        return _tail.findChild(id);
+    }
+    void setBasicProperty(uint8_t num, bool status) {
+        _tail.setBasicProperty(num, status);
+    }
+    static constexpr size_t maxUpdateSize() {
+        return EmbAJAXTypedList<Ts...>::maxUpdateSize();
+    }
+    static constexpr size_t footprint() {
+        return EmbAJAXTypedList<Ts...>::footprint();
+    }
+private:
+    const char* _head;
+    EmbAJAXTypedList<Ts...> _tail;
+};
+
+/** @brief A group of objects, whose types are known at compile time
+ *
+ *  Like EmbAJAXContainer, but print(), sendUpdates(), and findChild() do not need a virtual call per child. Use
+ *  MAKE_EmbAJAXTypedContainer() to create one. */
+template<typename... Ts> class EmbAJAXTypedContainer : public EmbAJAXBase {
+public:
+    constexpr EmbAJAXTypedContainer(Ts... children) : _children(children...) {}
+    void print() const override {
+        _children.print();
+    }
+    bool sendUpdates(uint16_t since, bool first) override {
+        return _children.sendUpdates(since, first);
+    }
+    EmbAJAXElement* findChild(const char* id) const override final {
+        return _children.findChild(id);
+    }
+    /** See EmbAJAXBase::maxUpdateSize(). Unlike for EmbAJAXContainer, this is known at compile time. */
+    static constexpr size_t maxUpdateSize() {
+        return EmbAJAXTypedList<Ts...>::maxUpdateSize();
+    }
+    static constexpr size_t childrenFootprint() {
+        return EmbAJAXTypedList<Ts...>::footprint();
+    }
+protected:
+    void setBasicProperty(uint8_t num, bool status) override {
+        _children.setBasicProperty(num, status);
+    }
+    EmbAJAXTypedList<Ts...> _children;
+};
+
+/** @brief A page, whose structure is known at compile time
+ *
+ *  This is an alternative to EmbAJAXPage, with the same interface. The difference is that the page is built from the
+ *  actual types of its elements, rather than from an array of EmbAJAXBase pointers. This allows the compiler to resolve,
+ *  and inline the walks over the element tree, which happen on each page load and on each poll from the client.
+ *  Further, static HTML can be specified as plain strings, instead of allocating EmbAJAXStatic objects on the heap.
+ *
+ *  The page, and all elements provided by EmbAJAX.h, other than EmbAJAXOptionSelect, and EmbAJAXRadioGroup, can be constant-initialized,
+ *  i.e. no code needs to run for them at startup. Constant children (such as a "constexpr EmbAJAXConnectionIndicator") may be passed as
+ *  const pointers, and are then placed in flash/.rodata, where the MCU allows this.
+ *
+ *  Use MAKE_EmbAJAXTypedPage() to create a page, as it will take care of deducing the type list:
+ *
+ *  @code
+ *  MAKE_EmbAJAXTypedPage(page, "Page title", "",
+ *      "<h1>Header</h1><p>",
+ *      &check,
+ *      "</p>",
+ *      &slider
+ *  )
+ *  @endcode
+ *
+ *  @note Element pointers are assumed to point to objects of exactly their static type (but plain EmbAJAXBase* or EmbAJAXElement*
+ *        pointers, such as returned by EmbAJAXRadioGroup::button(), are handled correctly, by means of virtual calls). If you
+ *        have a pointer to an intermediate base class, cast it to its actual type, or to EmbAJAXBase*.
+ *  @note Static strings are printed directly to the client. Adjacent static strings can be merged into a single literal by
+ *        writing them next to each other ("<p>" "text"), which saves an entry in the page's list of children. */
+template<typename... Ts> class EmbAJAXTypedPage : public EmbAJAXTypedContainer<Ts...>, public EmbAJAXPageBase {
+public:
+    /** Create a web page. See EmbAJAXPage::EmbAJAXPage() for details on the parameters. */
+    constexpr EmbAJAXTypedPage(const char* title, const char* header_add, uint16_t min_interval, Ts... children) : EmbAJAXTypedContainer<Ts...>(children...),
+        EmbAJAXPageBase(title, header_add, min_interval) {}
+    /** Duplication of print(), needed for internal reasons. Use print(), instead! */
+    void printPage() override {
+        print();
+    }
+    /** Serve the page including headers and all child elements. See EmbAJAXPage::print() */
+    void print() const override {
+        EMBAJAX_TRACE_SPAN("printPage", 0);
+        EmbAJAXBase::printPageHeader(_title, _header_add, _min_interval);
+        EmbAJAXTypedContainer<Ts...>::_children.print();
+        EmbAJAXBase::printPageFooter();
+    }
+    /** Handle AJAX client request. See EmbAJAXPage::handleRequest() */
+    void handleRequest(void (*change_callback)()=0) override {
+        EmbAJAXBase::handleRequest(change_callback, this);
+    }
+    /** Upper bound on the size of an update response for this page (i.e. a full resync, with all elements changed), computed at compile
+     *  time. Use this to check for oversized pages at build time, or to size buffers (see e.g. EmbAJAXOutputDriverESPAsync::setResponseBufferSize()):
+     *
+     *  @code
+     *  static_assert(decltype(page)::maxResponseSize() < 1460, "Page does not fit into a single TCP segment");
+     *  @endcode
+     *
+     *  See EmbAJAXBase::maxUpdateSize() for the contribution of each element (and the assumptions about the lengths of ids and texts). */
+    static constexpr size_t maxResponseSize() {
+        return EmbAJAXPageBase::maxResponseSize() + EmbAJAXTypedList<Ts...>::maxUpdateSize();
+    }
+    /** Static RAM occupied by this page, and all its elements (including those in typed containers), computed at compile time.
+     *  Static strings are not counted. Shorthand for EmbAJAXMemory::footprint(&page). */
+    static constexpr size_t footprint() {
+        return EmbAJAXMemory::footprint((const EmbAJAXTypedPage*) 0);
+    }
+};
+
+/** Internal helper for MAKE_EmbAJAXTypedPage(). Used for type deduction, only (not implemented). */
+template<typename... Ts> EmbAJAXTypedPage<Ts...> EmbAJAXTypedPageFor(Ts... children);
+/** Internal helper for MAKE_EmbAJAXTypedContainer(). Used for type deduction, only (not implemented). */
+template<typename... Ts> EmbAJAXTypedContainer<Ts...> EmbAJAXTypedContainerFor(Ts... children);
+
+/** Convenience macro to set up an EmbAJAXTypedPage. Usage is the same as for MAKE_EmbAJAXPage(), but static HTML may be
+ *  given as plain strings.
+ *  @param name Variable name of the page instance
+ *  @param title HTML Title
+ *  @param header_add a custom string to add to the HTML header section, e.g. a CSS definition. */
+#define MAKE_EmbAJAXTypedPage(name, title, header_add, ...) \
+    decltype(EmbAJAXTypedPageFor(__VA_ARGS__)) name(title, header_add, 100, __VA_ARGS__);
+
+/** Convenience macro to set up an EmbAJAXTypedContainer.
+ *  @param name Variable name of the container instance */
+#define MAKE_EmbAJAXTypedContainer(name, ...) \
+    decltype(EmbAJAXTypedContainerFor(__VA_ARGS__)) name(__VA_ARGS__);
+
+#endif
@@ -0,0 +1,88 @@
+/* Blink example, using a page whose structure is known at compile time (EmbAJAXTypedPage), and the
+ * lightweight raw socket output driver, which works directly on top of a WiFiServer (no web server
+ * library needed, and connections are kept open between polls).
+ *
+ * Since the types of all elements are known, the compiler can check the size of update responses, and
+ * the RAM taken by the page, at build time. Further, static HTML can be given as plain strings.
+ *
+ * The uptime is shown in an EmbAJAXLazySpan: It is computed only while a client is polling for updates.
+ *
+ * This example code is in the public domain (CONTRARY TO THE LIBRARY ITSELF). */
+
+#if defined (ESP8266)
+#include <ESP8266WiFi.h>
+#else
+#include <WiFi.h>
+#endif
+#define EmbAJAXOutputDriverWebServerClass WiFiServer
+#include <EmbAJAXOutputDriverRawSocket.h>
+#include <EmbAJAX.h>
+#include <EmbAJAXTypedPage.h>
+
+#define LEDPIN LED_BUILTIN
+
+// Set up the server, and register it with EmbAJAX
+EmbAJAXOutputDriverWebServerClass server(80);
+EmbAJAXOutputDriver driver(&server);
+
+// Define the main elements of interest as variables, so we can access to them later in our sketch.
+const char* modes[] = {"On", "Blink", "Off"};
+EmbAJAXRadioGroup<3> mode("mode", modes);
+EmbAJAXSlider blinkfreq("blfreq", 0, 1000, 100);   // slider, from 0 to 1000, initial value 100
+
+// Called while answering a poll, only
+void printUptime(char* buf, size_t size, const void*) {
+  snprintf(buf, size, "%lu s", (unsigned long) (millis() / 1000));
+}
+EmbAJAXLazySpan<16> uptime("uptime", printUptime);  // holds up to 15 characters
+
+// Define a page (named "page") with our elements of interest, above, interspersed by some static HTML.
+MAKE_EmbAJAXTypedPage(page, "EmbAJAX example - Typed page", "",
+  "<h1>Control the builtin LED</h1><p>Set the LED to: ",
+  &mode,
+  "</p><p>Blink frequency: <i>SLOW</i>",
+  &blinkfreq,
+  "<i>FAST</i></p><p>Uptime: ",
+  &uptime,
+  "</p>"
+)
+
+// These are checked by the compiler. Try adding more elements to the page.
+static_assert(decltype(page)::maxResponseSize() < 1460, "Update responses do not fit into a single TCP segment");
+static_assert(decltype(page)::footprint() < 1024, "Page takes too much RAM");
+
+void setup() {
+  Serial.begin(115200);
+
+  // Example WIFI setup as an access point. Change this to whatever suits you, best.
+  WiFi.mode(WIFI_AP);
+  WiFi.softAPConfig (IPAddress (192,168,4,1), IPAddress (0,0,0,0), IPAddress (255,255,255,0));
+  WiFi.softAP("EmbAJAXTest", "12345678");
+
+  // Tell the server to serve our EmbAJAX test page on root
+  driver.installPage(&page, "/", updateUI);
+  server.begin();
+
+  pinMode(LEDPIN, OUTPUT);
+
+  // The same numbers are available for pages that are not typed, but you have to list the elements yourself
+  Serial.print("Largest update response (bytes): ");
+  Serial.println(EmbAJAXPageBase::maxResponseSize(&mode, &blinkfreq, &uptime));
+  Serial.print("RAM used by the page (bytes): ");
+  Serial.println(EmbAJAXMemory::footprint(&page));
+}
+
+void updateUI() {
+  blinkfreq.setEnabled(mode.selectedOption() == 1);
+}
+
+void loop() {
+  // handle network. For the raw socket driver, this accepts connections, and parses and answers requests, as they come in.
+  driver.loopHook();
+
+  if (mode.selectedOption() == 1) { // blink
+      digitalWrite(LEDPIN, (millis() / (1100 - blinkfreq.intValue())) % 2);
+  } else {  // on or off
+      digitalWrite(LEDPIN, mode.selectedOption() != 0);
+  }
+}
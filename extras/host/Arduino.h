@@ -0,0 +1,120 @@
+/*
+ *
+ * EmbAJAX - Simplistic framework for creating and handling displays and controls on a WebPage served by an Arduino (or other small device).
+ *
+ * Copyright (C) 2018-2023 Thomas Friedrichsmeier
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+/** @file
+ *  The bare minimum of the Arduino API needed to compile EmbAJAX on a (POSIX) PC, for testing, only. */
+
+#ifndef EMBAJAX_HOST_ARDUINO_H
+#define EMBAJAX_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+
+typedef uint8_t byte;
+
+inline unsigned long millis() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000ul + ts.tv_nsec / 1000000;
+}
+inline unsigned long micros() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ul + ts.tv_nsec / 1000;
+}
+inline void delay(unsigned long ms) {
+    timespec ts = { (time_t) (ms / 1000), (long) (ms % 1000) * 1000000 };
+    nanosleep(&ts, 0);
+}
+inline void noInterrupts() {}
+inline void interrupts() {}
+inline char* itoa(int value, char* buf, int base) {
+    sprintf(buf, base == 16 ? "%x" : "%d", value);
+    return buf;
+}
+inline char* ltoa(long value, char* buf, int base) {
+    sprintf(buf, base == 16 ? "%lx" : "%ld", value);
+    return buf;
+}
+inline char* ultoa(unsigned long value, char* buf, int base) {
+    sprintf(buf, base == 16 ? "%lx" : "%lu", value);
+    return buf;
+}
+template<class A, class B> auto min(A a, B b) -> decltype(a < b ? a : b) { return a < b ? a : b; }
+template<class A, class B> auto max(A a, B b) -> decltype(a < b ? a : b) { return a > b ? a : b; }
+
+class __FlashStringHelper;
+#define F(X) (reinterpret_cast<const __FlashStringHelper*>(X))
+#define PROGMEM
+#define PGM_P const char*
+#define memcpy_P memcpy
+#define strlen_P strlen
+
+class Print {
+public:
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buf, size_t size) {
+        for (size_t i = 0; i < size; ++i) write(buf[i]);
+        return size;
+    }
+    size_t print(const char* s) { return write((const uint8_t*) s, strlen(s)); }
+    size_t print(const __FlashStringHelper* s) { return print(reinterpret_cast<const char*>(s)); }
+    virtual ~Print() {}
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() {}
+};
+
+class IPAddress {
+public:
+    IPAddress() {}
+    IPAddress(uint8_t, uint8_t, uint8_t, uint8_t) {}
+};
+
+class Client : public Stream {
+public:
+    virtual int connect(IPAddress ip, uint16_t port) = 0;
+    virtual int connect(const char *host, uint16_t port) = 0;
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t size) = 0;
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int read(uint8_t *buf, size_t size) = 0;
+    virtual int peek() = 0;
+    virtual void flush() = 0;
+    virtual void stop() = 0;
+    virtual uint8_t connected() = 0;
+    virtual operator bool() = 0;
+    using Print::write;
+};
+
+#endif
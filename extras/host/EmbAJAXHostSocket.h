@@ -0,0 +1,124 @@
+/*
+ *
+ * EmbAJAX - Simplistic framework for creating and handling displays and controls on a WebPage served by an Arduino (or other small device).
+ *
+ * Copyright (C) 2018-2023 Thomas Friedrichsmeier
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef EMBAJAXHOSTSOCKET_H
+#define EMBAJAXHOSTSOCKET_H
+
+#include <Arduino.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/** @brief Arduino Client on top of a POSIX socket, for running EmbAJAXOutputDriverRawSocket on a PC
+ *
+ *  Like WiFiClient, or EthernetClient, copies of an object refer to the same connection. Reading never blocks. */
+class EmbAJAXHostClient : public Client {
+public:
+    EmbAJAXHostClient(int fd=-1) : _fd(fd) {}
+    int connect(IPAddress, uint16_t) override { return 0; }
+    int connect(const char *host, uint16_t port) override {
+        stop();
+        _fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        inet_pton(AF_INET, host, &addr.sin_addr);
+        if (::connect(_fd, (sockaddr*) &addr, sizeof(addr)) != 0) stop();
+        return _fd >= 0;
+    }
+    size_t write(uint8_t c) override {
+        return write(&c, 1);
+    }
+    size_t write(const uint8_t *buf, size_t size) override {
+        size_t done = 0;
+        while (_fd >= 0 && done < size) {
+            ssize_t res = send(_fd, buf + done, size - done, MSG_NOSIGNAL);
+            if (res <= 0) break;
+            done += res;
+        }
+        return done;
+    }
+    int available() override {
+        int n = 0;
+        if (_fd < 0 || ioctl(_fd, FIONREAD, &n) != 0) return 0;
+        return n;
+    }
+    int read() override {
+        uint8_t c;
+        return (read(&c, 1) == 1) ? c : -1;
+    }
+    int read(uint8_t *buf, size_t size) override {
+        if (_fd < 0) return -1;
+        return recv(_fd, buf, size, MSG_DONTWAIT);
+    }
+    int peek() override {
+        uint8_t c;
+        if (_fd < 0 || recv(_fd, &c, 1, MSG_DONTWAIT | MSG_PEEK) != 1) return -1;
+        return c;
+    }
+    void flush() override {}
+    void stop() override {
+        if (_fd >= 0) close(_fd);
+        _fd = -1;
+    }
+    /** @returns false, once the peer has closed the connection (and all data has been read) */
+    uint8_t connected() override {
+        if (_fd < 0) return false;
+        uint8_t c;
+        return (recv(_fd, &c, 1, MSG_DONTWAIT | MSG_PEEK) != 0);
+    }
+    operator bool() override {
+        return _fd >= 0;
+    }
+private:
+    int _fd;
+};
+
+/** @brief Minimal stand-in for WiFiServer, or EthernetServer, listening on a local TCP port. */
+class EmbAJAXHostServer {
+public:
+    EmbAJAXHostServer(uint16_t port) : _port(port), _fd(-1) {}
+    /** @returns false, if the port could not be opened */
+    bool begin() {
+        _fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(_port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(_fd, (sockaddr*) &addr, sizeof(addr)) != 0 || listen(_fd, 4) != 0) return false;
+        fcntl(_fd, F_SETFL, O_NONBLOCK);
+        return true;
+    }
+    /** @returns the next incoming connection, or an invalid client, if none is waiting */
+    EmbAJAXHostClient accept() {
+        return EmbAJAXHostClient(_fd < 0 ? -1 : ::accept(_fd, 0, 0));
+    }
+private:
+    uint16_t _port;
+    int _fd;
+};
+
+#endif
@@ -0,0 +1,150 @@
+/*
+ *
+ * EmbAJAX - Simplistic framework for creating and handling displays and controls on a WebPage served by an Arduino (or other small device).
+ *
+ * Copyright (C) 2018-2023 Thomas Friedrichsmeier
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+/* Exercises EmbAJAXOutputDriverRawSocket over real sockets, on a PC. Build and run from the top level directory with:
+ *
+ *   g++ -std=gnu++11 -Wall -Iextras/host -I. -DEMBAJAX_REQUEST_TIMEOUT=200 -o test_rawsocket EmbAJAX.cpp extras/host/test_rawsocket.cpp
+ *   ./test_rawsocket
+ *
+ * (EMBAJAX_REQUEST_TIMEOUT must match for both files.) Optional features, such as EMBAJAX_TRACE, can be enabled the same way. */
+
+#include "EmbAJAXHostSocket.h"
+#define EmbAJAXOutputDriverWebServerClass EmbAJAXHostServer
+#include <EmbAJAXOutputDriverRawSocket.h>
+#include <EmbAJAX.h>
+
+EmbAJAXHostServer server(18080);
+EmbAJAXOutputDriver driver(&server);
+
+EmbAJAXSlider slider("slider", 0, 100, 50);
+EmbAJAXMutableSpan display("display");
+char display_buf[8];
+MAKE_EmbAJAXPage(page, "Host test", "",
+    &slider,
+    &display
+)
+
+void updateUI() {
+    display.setValue(itoa(slider.intValue(), display_buf, 10));
+}
+
+int failures = 0;
+void check(bool ok, const char* what) {
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) ++failures;
+}
+
+/** Send a piece of a request, and let the driver handle whatever it received. @returns the time spent in loopHook(), in ms */
+unsigned long sendPiece(EmbAJAXHostClient &client, const char* piece) {
+    client.write((const uint8_t*) piece, strlen(piece));
+    delay(20);
+    unsigned long start = millis();
+    driver.loopHook();
+    return millis() - start;
+}
+
+/** Collect the response(s) received so far, and @returns the number of complete (chunked) responses in it */
+int receive(EmbAJAXHostClient &client, char* buf, size_t bufsize) {
+    size_t len = 0;
+    for (int idle = 0; idle < 5 && len < bufsize - 1; ++idle) {
+        delay(5);
+        int res = client.read((uint8_t*) buf + len, bufsize - 1 - len);
+        if (res > 0) {
+            len += res;
+            idle = 0;
+        }
+    }
+    buf[len] = '\0';
+    int count = 0;
+    for (const char* p = buf; (p = strstr(p, "\r\n0\r\n\r\n")); ++p) ++count;
+    return count;
+}
+
+#if EMBAJAX_TRACE
+/** Print collecting the output in a buffer */
+class BufferPrint : public Print {
+public:
+    BufferPrint(char* buf, size_t size) : _buf(buf), _size(size), _len(0) {
+        _buf[0] = '\0';
+    }
+    size_t write(uint8_t c) override {
+        if (_len + 1 >= _size) return 0;
+        _buf[_len++] = c;
+        _buf[_len] = '\0';
+        return 1;
+    }
+private:
+    char* _buf;
+    size_t _size;
+    size_t _len;
+};
+#endif
+
+int main() {
+    if (!server.begin()) {
+        printf("Could not open port\n");
+        return 1;
+    }
+    driver.installPage(&page, "/", updateUI);
+    static char buf[32768];
+
+    EmbAJAXHostClient client;
+    check(client.connect("127.0.0.1", 18080), "connect");
+    driver.loopHook();  // accept
+
+    // A request arriving in pieces is answered once complete, without blocking in between
+    check(sendPiece(client, "GET / HTTP/1.1\r\nHo") < 10, "partial request does not block");
+    check(receive(client, buf, sizeof(buf)) == 0 && buf[0] == '\0', "no response to partial request");
+    sendPiece(client, "st: localhost\r\n\r\n");
+    check(receive(client, buf, sizeof(buf)) == 1 && strstr(buf, "HTTP/1.1 200 OK") && strstr(buf, "id=\"slider\""), "page served");
+
+    // Pipelined requests are answered in order, on the same connection
+    sendPiece(client, "POST / HTTP/1.1\r\nContent-Length: 35\r\n\r\nid=slider&value=42&revision=0&cid=1"
+                      "POST / HTTP/1.1\r\nContent-Length: 2");
+    sendPiece(client, "7\r\n\r\nid=&value=&revision=0&cid=2");
+    check(receive(client, buf, sizeof(buf)) == 2 && !strstr(buf, "404"), "two pipelined responses");
+    check(slider.intValue() == 42 && strcmp(display.value(), "42") == 0, "value received");
+    check(strstr(buf, "\"display\"") && strstr(buf, "\"42\""), "update sent");
+
+    // Unknown path
+    sendPiece(client, "GET /nope HTTP/1.1\r\n\r\n");
+    receive(client, buf, sizeof(buf));
+    check(strstr(buf, "404 Not Found") != 0, "unknown path");
+
+    // An incomplete request is dropped after EMBAJAX_REQUEST_TIMEOUT
+    sendPiece(client, "POST / HTTP/1.1\r\nContent-Length: 100\r\n\r\nid=");
+    check(client.connected(), "incomplete request is kept, at first");
+    delay(EMBAJAX_REQUEST_TIMEOUT + 50);
+    driver.loopHook();
+    delay(20);
+    check(!client.connected(), "incomplete request times out");
+
+#if EMBAJAX_TRACE
+    // Spans recorded while handling the above requests can be dumped from the host
+    BufferPrint out(buf, sizeof(buf));
+    EmbAJAXTrace::dump(out);
+    check(strncmp(buf, "{\"traceEvents\":[", 16) == 0 && strstr(buf, "\"name\":\"handleRequest\"") && strstr(buf, "\"id\":\"slider\""), "trace dump");
+#endif
+
+    client.stop();
+    printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,65 @@
+/*
+ *
+ * EmbAJAX - Simplistic framework for creating and handling displays and controls on a WebPage served by an Arduino (or other small device).
+ *
+ * Copyright (C) 2018-2023 Thomas Friedrichsmeier
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+/* Exercises EmbAJAXThrottle, on a PC. Build and run from the top level directory with:
+ *
+ *   g++ -std=gnu++11 -Wall -Iextras/host -I. -o test_throttle EmbAJAX.cpp extras/host/test_throttle.cpp
+ *   ./test_throttle */
+
+// No output driver needed
+#define EMBAJAX_OUTUPUTDRIVER_IMPLEMENTATION
+#include <EmbAJAX.h>
+
+int failures = 0;
+void check(bool ok, const char* what) {
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) ++failures;
+}
+
+/** Call accept(value) every 10 ms (as a sketch would from loop()), and due() alongside (as polls would), for at most ms milliseconds.
+ *  @returns the time until either returned true, or -1 */
+long repeat(EmbAJAXThrottle &t, int16_t value, unsigned long ms) {
+    unsigned long start = millis();
+    while (millis() - start < ms) {
+        if (t.accept(value) || t.due()) return millis() - start;
+        delay(10);
+    }
+    return -1;
+}
+
+int main() {
+    EmbAJAXThrottle t(100, 10, 0, 500);
+    t.sync(50);
+    delay(110);
+    long sent = repeat(t, 55, 1500);
+    check(sent >= 490 && sent < 700, "value within deadband, set repeatedly, is sent once settled");
+    check(repeat(t, 55, 300) < 0, "... and only once");
+    check(!EmbAJAXThrottle::pending(), "nothing pending afterwards");
+
+    t.accept(58);
+    check(EmbAJAXThrottle::pending(), "change within deadband is held back");
+    check(repeat(t, 55, 800) < 0 && !EmbAJAXThrottle::pending(), "returning to the value sent clears the held back change");
+
+    check(repeat(t, 80, 50) == 0, "change outside deadband is sent immediately");
+
+    printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
@@ -33,12 +33,28 @@
 #define PLAIN_STRING_ARG "\14"
 #define INTEGER_VALUE_ARG "\15"
 
-/* //////////// String formatting macros //////////////// 
+/* //////////// Minification ////////////////
  *
- * The user-facing macro here is printFormatted(). This takes static strings and args in a
- * and re-aggranges them so that static strings are merged into one, and the variable args args
- * are appended at the end (suitable for EmbAJAXOutputDriverBase::printContentF(). */
+ * Static HTML/JS/JSON code is written without indentation inside the string literals, and line breaks
+ * are inserted using EMBAJAX_NL, only. Thus, the readable form is kept in the source, but only the minified
+ * form ends up in flash (unless EMBAJAX_MINIFY is 0). Note that JS code written this way must not rely on
+ * automatic semicolon insertion. */
 
+/** Line break in generated code. Expands to an empty string, unless EMBAJAX_MINIFY is 0. */
+#if EMBAJAX_MINIFY
+ #define EMBAJAX_NL ""
+#else
+ #define EMBAJAX_NL "\n"
+#endif
+
+/* //////////// String formatting macros ////////////////
+ *
+ * The user-facing macro here is printFormatted(). Where static strings need to be wrapped into F() (USE_PROGMEM_STRINGS), this
+ * takes static strings and args in a and re-aggranges them so that static strings are merged into one, and the variable args args
+ * are appended at the end (suitable for EmbAJAXOutputDriverBase::printContentF(). Otherwise, printFormatted() is a variadic
+ * template member of EmbAJAXOutputDriverBase, and the argument macros wrap values in typed helper objects. */
+
+#if USE_PROGMEM_STRINGS
 // See https://stackoverflow.com/questions/11761703/overloading-macro-on-number-of-arguments
 #define GET_MACRO(_1,_2,_3,_4,_5,_6,_7,_8,_9,_10,_11,_12,_13,_14,_15,_16,_17,_18,_19,_20,_21,_22,_23,_24,_25,_26,NAME,...) NAME
 #define printF_(...) GET_MACRO(__VA_ARGS__, printF_26, printF_25, printF_24, printF_23, printF_22, printF_21, printF_20, printF_19, printF_18, printF_17, printF_16, printF_15, printF_14, printF_13, printF_12, printF_11, printF_10, printF_9, printF_8, printF_7, printF_6, printF_5, printF_4, printF_3, printF_2, printF_1)(__VA_ARGS__)
@@ -54,6 +70,13 @@
 #define PLAIN_STRING(X) PLAIN_STRING_ARG, (const char*) X
 /** For use in #printFormatted(): Insert an integer value as a string (base 10). */
 #define INTEGER_VALUE(X) INTEGER_VALUE_ARG, (int) X
+#else
+#define JS_QUOTED_STRING(X) EmbAJAXFormatStringArg<JS_QUOTED_STRING_ARG[0]>{(const char*) X}
+#define HTML_QUOTED_STRING(X) EmbAJAXFormatStringArg<HTML_QUOTED_STRING_ARG[0]>{(const char*) X}
+#define HTML_ESCAPED_STRING(X) EmbAJAXFormatStringArg<HTML_ESCAPED_STRING_ARG[0]>{(const char*) X}
+#define PLAIN_STRING(X) EmbAJAXFormatStringArg<PLAIN_STRING_ARG[0]>{(const char*) X}
+#define INTEGER_VALUE(X) EmbAJAXFormatIntegerArg{(int) X}
+#endif
 
     /** \def printFormatted()
      *  @brief Print a static string with parameters replaced, roughly similar to printf
@@ -67,17 +90,21 @@
      *                          " oninput=\"doRequest(this.id, this.value);\" onchange=\"oninput();\"/>");
      *  @endcode
      *
-     *  First thing to note is that - although this function is technically implemented as a macro - it behaves like a
-     *  public member function of EmbAJAXOutputDriverBase. Actually the macro relays to appropriate helper functions in that class.
+     *  First thing to note is that - although this function is technically implemented as a macro, if USE_PROGMEM_STRINGS is set - it
+     *  behaves like a public member function of EmbAJAXOutputDriverBase. Actually the macro relays to appropriate helper functions in that class.
      *
      *  Arguments can be either string literals, or values. These two kinds of argument have to be used alternatingly (which is usually
      *  needed, anyway), i.e. "string", value, "string", value... Values have to be wrapped by one of #HTML_QUOTED_STRING(), #INTEGER_VALUE(),
      *  #HTML_ESCAPED_STRING, JS_QUOTED_STRING, PLAIN_STRING, which will control just how the value is inserted (with of without quotes, with
      *  HTML entities escaped, etc.).
      *
-     *  Internally, all static portions of the output will be concatenated to a single string, which - on architectures where it matters -
-     *  will automatically be wrapped inside an F() macro, for storage in FLASH memory, thus helping a lot to reduce RAM usage (not yet implemented,
-     *  to come soon).
+     *  If USE_PROGMEM_STRINGS is set, all static portions of the output will be concatenated to a single string, which will automatically
+     *  be wrapped inside an F() macro, for storage in FLASH memory, thus helping a lot to reduce RAM usage. The number of arguments is limited
+     *  to 25, in this case.
+     *
+     *  Otherwise, printFormatted() is a variadic template. Static strings are passed on with their length known at compile time, and
+     *  each value is handled according to its (wrapper) type. Passing an unwrapped value results in a compile time error. There is
+     *  no limit on the number of arguments.
      *
      *  For efficiency reasons, you should try to merge as many bits of output in a single printFormatted(), as possible. I.e. instead of
      *  @code{.cpp}
@@ -86,11 +113,14 @@
      *  @endcode
      *  always use:
      *  @code{.cpp}
-     *  _driver->printFormatted("id=", HTML_QUOTED_STRING(_id), _driver->printFormatted(" value=", INTEGER_VALUE(_value));
+     *  _driver->printFormatted("id=", HTML_QUOTED_STRING(_id), " value=", INTEGER_VALUE(_value));
      *  @endcode
      * */
+#if USE_PROGMEM_STRINGS
 #define printFormatted(...) printF_(__VA_ARGS__)
 
+#define printF_1(F1) printF_proxy0(F1)
+//#define printF_2(...) // Not validly possible, as we always follow fmt, arg, fmt, arg...
 #define printF_3(F1, A1a, A1b) printF_proxy((F1 A1a), A1b)
 #define printF_4(F1, A1a, A1b, F2) printF_proxy((F1 A1a F2), A1b)
 //#define printF_5(...) // Not validly possible, as we always follow fmt, arg, fmt, arg...
@@ -115,10 +145,8 @@
 #define printF_24(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5, A5a, A5b, F6, A6a, A6b, F7, A7a, A7b, F8, A8a, A8b) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5 A5a F6 A6a F7 A7a F8 A8a), A1b, A2b, A3b, A4b, A5b, A6b, A7b, A8b)
 #define printF_25(F1, A1a, A1b, F2, A2a, A2b, F3, A3a, A3b, F4, A4a, A4b, F5, A5a, A5b, F6, A6a, A6b, F7, A7a, A7b, F8, A8a, A8b, F9) printF_proxy((F1 A1a F2 A2a F3 A3a F4 A4a F5 A5a F6 A6a F7 A7a F8 A8a F9), A1b, A2b, A3b, A4b, A5b, A6b, A7b, A8b)
 
-#if USE_PROGMEM_STRINGS
- #define printF_proxy(X, ...) _printContentF(F(X), __VA_ARGS__);
-#else
- #define printF_proxy(X, ...) _printContentF(X, __VA_ARGS__);
+#define printF_proxy(X, ...) _printContentF(F(X), __VA_ARGS__);
+#define printF_proxy0(X) _printContentF(F(X));
 #endif
 
 #ifndef UNUSED